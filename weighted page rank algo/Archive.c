@@ -0,0 +1,321 @@
+// Archive.c - Implementation of the packed collection archive
+//
+// The layout is one file that is mapped into memory:
+//     header
+//     collection.txt, as it was
+//     url table: the url of every page, nul-terminated, back to back
+//     offset index: where each page's name and body are
+//     page bodies, back to back in collection order
+// so reading a page is a lookup in the index instead of an open().
+
+// Written by: Bianca Ren
+// Date: 14th Nov 2022
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Archive.h"
+
+#define ARCHIVE_MAGIC "WPRPAK1"
+// size of each read() while copying a page into the archive
+#define COPY_CHUNK (1 << 16)
+
+struct archiveHeader {
+    char magic[8];
+    uint32_t numPages;
+    uint32_t namesSize;
+    uint64_t collectionOffset;
+    uint64_t collectionSize;
+    uint64_t namesOffset;
+    uint64_t pagesOffset;
+    uint64_t size;
+};
+
+struct pageEntry {
+    uint64_t body;          // offset from the start of the file
+    uint64_t size;
+    uint32_t name;          // offset from the start of the url table
+    uint32_t reserved;
+};
+
+struct archiveRep {
+    const unsigned char *data;
+    size_t size;
+
+    const struct archiveHeader *header;
+    const struct pageEntry *pages;
+    const char *names;
+};
+
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static uint64_t alignUp(uint64_t n) {
+    return (n + 7) & ~(uint64_t) 7;
+}
+
+/*
+ * Append the file to the archive, storing its size. Returns false if it
+ * can't be read or written out
+ */
+static bool copyFile(const char *path, FILE *out, char *buf, 
+                     uint64_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return false;
+    }
+
+    bool ok = true;
+    ssize_t n;
+    *size = 0;
+    while (ok && (n = read(fd, buf, COPY_CHUNK)) != 0) {
+        ok = n > 0 && fwrite(buf, 1, n, out) == (size_t) n;
+        *size += ok ? n : 0;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "Can't copy %s\n", path);
+    }
+    close(fd);
+    return ok;
+}
+
+/*
+ * Read the url table out of ./collection.txt into *names, storing its 
+ * size and the number of urls. Returns false if either doesn't fit the
+ * 32 bits the header and the offset index keep them in
+ */
+static bool readNames(char **names, uint32_t *namesSize, int *numPages) {
+    Reader collection = ReaderOpen("./collection.txt");
+    if (collection == NULL) {
+        fprintf(stderr, "Can't open ./collection.txt\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t size = 0;
+    size_t cap = 64;
+    *names = checkAlloc(malloc(cap));
+    *numPages = 0;
+    bool fits = true;
+    Span url;
+    while (ReaderToken(collection, &url)) {
+        if (url.len >= UINT32_MAX - size || *numPages == INT32_MAX) {
+            fits = false;
+            break;
+        }
+
+        while (size + url.len + 1 > cap) {
+            cap *= 2;
+            *names = checkAlloc(realloc(*names, cap));
+        }
+
+        memcpy(*names + size, url.start, url.len);
+        (*names)[size + url.len] = '\0';
+        size += url.len + 1;
+        (*numPages)++;
+    }
+
+    ReaderClose(collection);
+
+    if (!fits) {
+        fprintf(stderr, "./collection.txt has too many urls to pack\n");
+    }
+    *namesSize = size;
+    return fits;
+}
+
+bool ArchivePack(const char *path) {
+    // the url table comes straight from the collection
+    char *names;
+    uint32_t namesSize;
+    int numPages;
+    if (!readNames(&names, &namesSize, &numPages)) {
+        free(names);
+        return false;
+    }
+
+    // written beside the archive and only renamed over it once complete
+    size_t tmpSize = strlen(path) + sizeof(".tmp");
+    char *tmpPath = checkAlloc(malloc(tmpSize));
+    snprintf(tmpPath, tmpSize, "%s.tmp", path);
+
+    FILE *fp = fopen(tmpPath, "wb");
+    if (fp == NULL) {
+        free(tmpPath);
+        free(names);
+        return false;
+    }
+
+    struct archiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    header.numPages = numPages;
+    header.namesSize = namesSize;
+    header.collectionOffset = sizeof(header);
+
+    // the header and the index are written last, once the sizes are known
+    char *buf = checkAlloc(malloc(COPY_CHUNK));
+    bool ok = fseek(fp, header.collectionOffset, SEEK_SET) == 0;
+    ok = ok && copyFile("./collection.txt", fp, buf, 
+                        &header.collectionSize);
+    header.namesOffset = header.collectionOffset + header.collectionSize;
+    header.pagesOffset = alignUp(header.namesOffset + namesSize);
+
+    struct pageEntry *pages = checkAlloc(calloc(numPages + 1, 
+                                                sizeof(*pages)));
+    char *pagePath = NULL;
+    size_t pathCap = 0;
+    uint64_t at = header.pagesOffset + numPages * sizeof(*pages);
+    ok = ok && fseek(fp, at, SEEK_SET) == 0;
+
+    uint32_t nameAt = 0;
+    for (int i = 0; ok && i < numPages; i++) {
+        const char *name = names + nameAt;
+        size_t len = strlen(name);
+        if (len + 5 > pathCap) {
+            pathCap = len + 5;
+            pagePath = checkAlloc(realloc(pagePath, pathCap));
+        }
+        snprintf(pagePath, pathCap, "%s.txt", name);
+
+        pages[i].name = nameAt;
+        pages[i].body = at;
+        ok = copyFile(pagePath, fp, buf, &pages[i].size);
+        at += pages[i].size;
+        nameAt += len + 1;
+    }
+    header.size = at;
+
+    static const char padding[8];
+    size_t padSize = header.pagesOffset - header.namesOffset - namesSize;
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0 &&
+         fwrite(&header, sizeof(header), 1, fp) == 1 &&
+         fseek(fp, header.namesOffset, SEEK_SET) == 0 &&
+         fwrite(names, 1, namesSize, fp) == namesSize &&
+         fwrite(padding, 1, padSize, fp) == padSize &&
+         fwrite(pages, sizeof(*pages), numPages, fp) == (size_t) numPages;
+
+    free(pages);
+    free(names);
+    free(buf);
+    free(pagePath);
+
+    ok = fclose(fp) == 0 && ok && rename(tmpPath, path) == 0;
+    if (!ok) {
+        unlink(tmpPath);
+    }
+    free(tmpPath);
+    return ok;
+}
+
+/*
+ * Check that every section and page lies inside the file. Sizes are 
+ * compared with what is left after the offset, so a huge offset can't
+ * wrap around
+ */
+static bool validArchive(const unsigned char *data, size_t size) {
+    const struct archiveHeader *h = (const void *) data;
+    if (
+        memcmp(h->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 ||
+        h->size != size ||
+        h->collectionOffset > size ||
+        h->collectionSize > size - h->collectionOffset ||
+        h->namesOffset > size || h->namesSize > size - h->namesOffset ||
+        h->pagesOffset % 8 != 0 || h->pagesOffset > size ||
+        (uint64_t) h->numPages * sizeof(struct pageEntry) 
+            > size - h->pagesOffset ||
+        (h->namesSize > 0 && data[h->namesOffset + h->namesSize - 1] != '\0')
+    ) {
+        return false;
+    }
+
+    const struct pageEntry *pages = (const void *) (data + h->pagesOffset);
+    for (uint32_t i = 0; i < h->numPages; i++) {
+        if (
+            pages[i].name >= h->namesSize ||
+            pages[i].body > size || pages[i].size > size - pages[i].body
+        ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+Archive ArchiveOpen(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (
+        fstat(fd, &st) == -1 || 
+        st.st_size < (off_t) sizeof(struct archiveHeader)
+    ) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (!validArchive(data, st.st_size)) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    Archive a = checkAlloc(malloc(sizeof(*a)));
+    a->data = data;
+    a->size = st.st_size;
+    a->header = data;
+    a->pages = (const void *) (a->data + a->header->pagesOffset);
+    a->names = (const char *) a->data + a->header->namesOffset;
+
+    return a;
+}
+
+void ArchiveFree(Archive a) {
+    munmap((void *) a->data, a->size);
+    free(a);
+}
+
+Span ArchiveCollection(Archive a) {
+    Span s = { 
+        (const char *) a->data + a->header->collectionOffset,
+        a->header->collectionSize 
+    };
+    return s;
+}
+
+int ArchiveNumPages(Archive a) {
+    return a->header->numPages;
+}
+
+const char *ArchivePageName(Archive a, int page) {
+    return a->names + a->pages[page].name;
+}
+
+Span ArchivePage(Archive a, int page) {
+    Span s = {
+        (const char *) a->data + a->pages[page].body,
+        a->pages[page].size
+    };
+    return s;
+}
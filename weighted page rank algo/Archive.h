@@ -0,0 +1,57 @@
+// Archive.h - Interface to the packed collection archive
+
+// Written by: Bianca Ren
+// Date: 14th Nov 2022
+
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdbool.h>
+
+#include "Reader.h"
+
+// file `pageRank pack` writes when no name is given
+#define ARCHIVE_FILE "./collection.pack"
+
+typedef struct archiveRep *Archive;
+
+/**
+ * Bundles ./collection.txt and the page file of every url in it into one
+ * archive file. Returns false, leaving whatever was at path before, if a
+ * page can't be read, the collection is too big for the archive's 32-bit
+ * counts or the archive can't be written.
+ */
+bool ArchivePack(const char *path);
+
+/**
+ * Maps an archive into memory. Returns NULL if the file can't be opened
+ * or isn't a valid archive.
+ */
+Archive ArchiveOpen(const char *path);
+
+/**
+ * Unmaps the archive. Spans into it are no longer valid.
+ */
+void ArchiveFree(Archive a);
+
+/**
+ * Returns the contents of the packed collection.txt.
+ */
+Span ArchiveCollection(Archive a);
+
+/**
+ * Returns the number of pages, one for every url in the collection.
+ */
+int ArchiveNumPages(Archive a);
+
+/**
+ * Returns the url of the given page, in collection order.
+ */
+const char *ArchivePageName(Archive a, int page);
+
+/**
+ * Returns the contents of the given page's file.
+ */
+Span ArchivePage(Archive a, int page);
+
+#endif
@@ -0,0 +1,106 @@
+// Arena.c - Implementation of the region allocator
+//
+// Allocations are carved off the end of the current block. When it is
+// full a new block, twice as big as the last one up to ARENA_MAX_BLOCK,
+// is put in front of it, so freeing the arena walks the blocks and not
+// the objects.
+
+// Written by: Bianca Ren
+// Date: 14th Nov 2022
+
+#include <stdalign.h>
+#include <stdlib.h>
+
+#include "Arena.h"
+
+// size of the first block, in bytes
+#define ARENA_MIN_BLOCK 4096
+// blocks stop doubling at this size
+#define ARENA_MAX_BLOCK (1 << 20)
+#define ARENA_ALIGN alignof(max_align_t)
+
+struct arenaBlock {
+    struct arenaBlock *next;
+    size_t size;
+    size_t used;
+    alignas(max_align_t) unsigned char data[];
+};
+
+struct arenaRep {
+    struct arenaBlock *blocks;  // the current block, in front
+    size_t nextSize;
+    ArenaStats stats;
+};
+
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+Arena ArenaNew(const char *name) {
+    Arena a = checkAlloc(malloc(sizeof(*a)));
+
+    a->blocks = NULL;
+    a->nextSize = ARENA_MIN_BLOCK;
+    a->stats.name = name;
+    a->stats.allocations = 0;
+    a->stats.bytesUsed = 0;
+    a->stats.bytesReserved = 0;
+    a->stats.blocks = 0;
+
+    return a;
+}
+
+void ArenaFree(Arena a) {
+    struct arenaBlock *b = a->blocks;
+    while (b != NULL) {
+        struct arenaBlock *next = b->next;
+        free(b);
+        b = next;
+    }
+
+    free(a);
+}
+
+void *ArenaAlloc(Arena a, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    struct arenaBlock *b = a->blocks;
+    if (b == NULL || b->size - b->used < size) {
+        size_t blockSize = a->nextSize > size ? a->nextSize : size;
+        b = checkAlloc(malloc(sizeof(*b) + blockSize));
+        b->next = a->blocks;
+        b->size = blockSize;
+        b->used = 0;
+        a->blocks = b;
+
+        if (a->nextSize < ARENA_MAX_BLOCK) {
+            a->nextSize *= 2;
+        }
+
+        a->stats.bytesReserved += blockSize;
+        a->stats.blocks++;
+    }
+
+    void *p = b->data + b->used;
+    b->used += size;
+
+    a->stats.allocations++;
+    a->stats.bytesUsed += size;
+
+    return p;
+}
+
+ArenaStats ArenaGetStats(Arena a) {
+    return a->stats;
+}
+
+void ArenaReport(Arena a, FILE *out) {
+    fprintf(out, "arena %s: %zu allocations, %zu bytes used of %zu "
+            "reserved in %d blocks\n", a->stats.name, a->stats.allocations,
+            a->stats.bytesUsed, a->stats.bytesReserved, a->stats.blocks);
+}
@@ -0,0 +1,51 @@
+// Arena.h - Interface to the region allocator
+
+// Written by: Bianca Ren
+// Date: 14th Nov 2022
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct arenaRep *Arena;
+
+// what an arena has handed out so far
+typedef struct arenaStats {
+    const char *name;
+    size_t allocations;
+    size_t bytesUsed;       // bytes asked for, rounded up for alignment
+    size_t bytesReserved;   // bytes of the blocks behind them
+    int blocks;
+} ArenaStats;
+
+/**
+ * Creates a new, empty arena. The name is only used by the statistics
+ * and has to outlive the arena.
+ */
+Arena ArenaNew(const char *name);
+
+/**
+ * Frees the arena and everything allocated from it at once.
+ */
+void ArenaFree(Arena a);
+
+/**
+ * Returns size bytes from the arena, aligned for any type. The memory
+ * lives until the arena is freed; it can't be freed on its own. Exits
+ * if there is no memory. Not safe to call from several threads at once.
+ */
+void *ArenaAlloc(Arena a, size_t size);
+
+/**
+ * Returns the statistics of the arena.
+ */
+ArenaStats ArenaGetStats(Arena a);
+
+/**
+ * Prints the statistics of the arena as one line.
+ */
+void ArenaReport(Arena a, FILE *out);
+
+#endif
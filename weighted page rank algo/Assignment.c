@@ -0,0 +1,320 @@
+// Assignment.c - Implementation of the minimum cost assignment solver
+//
+// The Hungarian algorithm gives an optimal assignment and optimal dual
+// potentials. Every optimal assignment only uses "tight" pairs, whose 
+// cost equals the sum of the row and column potentials, and every
+// perfect matching of tight pairs is optimal. To list them in order,
+// Heap's recursion is replayed: generate(k) fixes the column of row
+// k - 1 for each of its k children in turn, and only the children that
+// can still be completed by tight pairs are entered. Children that are
+// skipped are replaced by the net effect generate(k - 1) has on the
+// array, so the walk only goes down paths that end in a tie.
+
+// Written by: Bianca Ren
+// Date: 13rd Nov 2022
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Assignment.h"
+
+// reduced costs this close to 0 count as tight
+#define TIGHT_EPSILON 1e-9
+
+struct tieBreak {
+    int n;
+    const bool *tight;      // tight[row * n + col]
+    int *a;                 // Heap's array, a[row] is a column
+    int *colOf;             // current tight perfect matching
+    int *rowOf;
+    bool *fixedRow;
+    bool *fixedCol;
+
+    // scratch for the augmenting path search
+    int *queue;
+    int *cameFrom;
+
+    AssignmentVisit visit;
+    void *arg;
+};
+
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static void swap(int *x, int *y) {
+    int temp = *x;
+    *x = *y;
+    *y = temp;
+}
+
+/*
+ * Hungarian algorithm with row potentials u and column potentials v 
+ * (1-indexed, as in the usual shortest augmenting path formulation).
+ * Stores the column of each row in colOf
+ */
+static void hungarian(const double *cost, int n, double *u, double *v,
+                      int *colOf) {
+    int *rowOfCol = checkAlloc(calloc(n + 1, sizeof(int)));
+    int *way = checkAlloc(calloc(n + 1, sizeof(int)));
+    double *minv = checkAlloc(malloc((n + 1) * sizeof(double)));
+    bool *used = checkAlloc(malloc((n + 1) * sizeof(bool)));
+
+    for (int i = 0; i <= n; i++) {
+        u[i] = 0.0;
+        v[i] = 0.0;
+    }
+
+    for (int i = 1; i <= n; i++) {
+        rowOfCol[0] = i;
+        int j0 = 0;
+
+        for (int j = 0; j <= n; j++) {
+            minv[j] = DBL_MAX;
+            used[j] = false;
+        }
+
+        do {
+            used[j0] = true;
+            int i0 = rowOfCol[j0];
+            int j1 = 0;
+            double delta = DBL_MAX;
+
+            for (int j = 1; j <= n; j++) {
+                if (used[j]) {
+                    continue;
+                }
+
+                double cur = cost[(i0 - 1) * n + (j - 1)] - u[i0] - v[j];
+                if (cur < minv[j]) {
+                    minv[j] = cur;
+                    way[j] = j0;
+                }
+                if (minv[j] < delta) {
+                    delta = minv[j];
+                    j1 = j;
+                }
+            }
+
+            for (int j = 0; j <= n; j++) {
+                if (used[j]) {
+                    u[rowOfCol[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minv[j] -= delta;
+                }
+            }
+
+            j0 = j1;
+        } while (rowOfCol[j0] != 0);
+
+        do {
+            int j1 = way[j0];
+            rowOfCol[j0] = rowOfCol[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+
+    for (int j = 1; j <= n; j++) {
+        colOf[rowOfCol[j] - 1] = j - 1;
+    }
+
+    free(rowOfCol);
+    free(way);
+    free(minv);
+    free(used);
+}
+
+/*
+ * Try to make (row, col) part of the matching without using any fixed 
+ * row or column. Row's old column and col's old row are left without a
+ * partner, so this looks for an alternating path of tight pairs from 
+ * the old row to the old column. Returns false (and changes nothing) if
+ * there is none, i.e. no optimal assignment contains (row, col).
+ */
+static bool fixPair(struct tieBreak *tb, int row, int col) {
+    int n = tb->n;
+    int freeCol = tb->colOf[row];
+    int freeRow = tb->rowOf[col];
+
+    if (!tb->tight[row * n + col]) {
+        return false;
+    } else if (freeCol == col) {
+        tb->fixedRow[row] = true;
+        tb->fixedCol[col] = true;
+        return true;
+    }
+
+    tb->fixedRow[row] = true;
+    tb->fixedCol[col] = true;
+
+    // breadth first search over columns, cameFrom[c] is the row that 
+    // reached column c
+    for (int c = 0; c < n; c++) {
+        tb->cameFrom[c] = -1;
+    }
+
+    int head = 0, tail = 0;
+    tb->queue[tail++] = freeRow;
+    bool found = false;
+
+    while (head < tail && !found) {
+        int r = tb->queue[head++];
+        for (int c = 0; c < n; c++) {
+            if (
+                tb->fixedCol[c] || tb->cameFrom[c] != -1 || 
+                !tb->tight[r * n + c]
+            ) {
+                continue;
+            }
+
+            tb->cameFrom[c] = r;
+            if (c == freeCol) {
+                found = true;
+                break;
+            }
+
+            int next = tb->rowOf[c];
+            if (!tb->fixedRow[next]) {
+                tb->queue[tail++] = next;
+            }
+        }
+    }
+
+    if (!found) {
+        tb->fixedRow[row] = false;
+        tb->fixedCol[col] = false;
+        return false;
+    }
+
+    // flip the path: every column on it takes the row that reached it
+    int c = freeCol;
+    while (true) {
+        int r = tb->cameFrom[c];
+        int prevCol = tb->colOf[r];
+        tb->colOf[r] = c;
+        tb->rowOf[c] = r;
+        if (r == freeRow) {
+            break;
+        }
+        c = prevCol;
+    }
+
+    tb->colOf[row] = col;
+    tb->rowOf[col] = row;
+
+    return true;
+}
+
+void AssignmentHeapSkip(int *a, int m) {
+    if (m < 2) {
+        return;
+    } else if (m == 2 || m % 2 == 1) {
+        swap(&a[0], &a[m - 1]);
+        return;
+    }
+
+    int first = a[0];
+    int second = a[1];
+    int third = a[m - 3];
+    int fourth = a[m - 2];
+    int last = a[m - 1];
+
+    memmove(a + 2, a + 1, (m - 4) * sizeof(int));
+    a[2] = second;
+    a[0] = third;
+    a[1] = fourth;
+    a[m - 2] = last;
+    a[m - 1] = first;
+}
+
+/*
+ * Walk generate(k), entering only the children whose fixed pair can 
+ * still be completed by tight pairs. Returns false once visit asks to 
+ * stop
+ */
+static bool enumerate(struct tieBreak *tb, int k) {
+    int *a = tb->a;
+    if (k <= 1) {
+        // every other column is fixed, so row 0's is tight as well
+        return tb->visit(tb->arg, a);
+    }
+
+    for (int i = 0; i < k; i++) {
+        int col = a[k - 1];
+        if (fixPair(tb, k - 1, col)) {
+            bool more = enumerate(tb, k - 1);
+            tb->fixedRow[k - 1] = false;
+            tb->fixedCol[col] = false;
+            if (!more) {
+                return false;
+            }
+        } else {
+            AssignmentHeapSkip(a, k - 1);
+        }
+
+        if (i < k - 1) {
+            swap(&a[k % 2 == 0 ? i : 0], &a[k - 1]);
+        }
+    }
+
+    return true;
+}
+
+void AssignmentSolve(const double *cost, int n, const int *start,
+                     AssignmentVisit visit, void *arg) {
+    if (n == 0) {
+        visit(arg, start);
+        return;
+    }
+
+    double *u = checkAlloc(malloc((n + 1) * sizeof(double)));
+    double *v = checkAlloc(malloc((n + 1) * sizeof(double)));
+    bool *tight = checkAlloc(malloc((size_t) n * n * sizeof(bool)));
+
+    struct tieBreak tb;
+    tb.n = n;
+    tb.tight = tight;
+    tb.a = checkAlloc(malloc(n * sizeof(int)));
+    tb.colOf = checkAlloc(malloc(n * sizeof(int)));
+    tb.rowOf = checkAlloc(malloc(n * sizeof(int)));
+    tb.fixedRow = checkAlloc(calloc(n, sizeof(bool)));
+    tb.fixedCol = checkAlloc(calloc(n, sizeof(bool)));
+    tb.queue = checkAlloc(malloc(n * sizeof(int)));
+    tb.cameFrom = checkAlloc(malloc(n * sizeof(int)));
+    tb.visit = visit;
+    tb.arg = arg;
+
+    hungarian(cost, n, u, v, tb.colOf);
+
+    for (int r = 0; r < n; r++) {
+        tb.rowOf[tb.colOf[r]] = r;
+        for (int c = 0; c < n; c++) {
+            double reduced = cost[r * n + c] - u[r + 1] - v[c + 1];
+            tight[r * n + c] = fabs(reduced) <= TIGHT_EPSILON;
+        }
+    }
+
+    memcpy(tb.a, start, n * sizeof(int));
+    enumerate(&tb, n);
+
+    free(u);
+    free(v);
+    free(tight);
+    free(tb.a);
+    free(tb.colOf);
+    free(tb.rowOf);
+    free(tb.fixedRow);
+    free(tb.fixedCol);
+    free(tb.queue);
+    free(tb.cameFrom);
+}
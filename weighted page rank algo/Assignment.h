@@ -0,0 +1,37 @@
+// Assignment.h - Interface to the minimum cost assignment solver
+
+// Written by: Bianca Ren
+// Date: 13rd Nov 2022
+
+#ifndef ASSIGNMENT_H
+#define ASSIGNMENT_H
+
+#include <stdbool.h>
+
+/**
+ * Called with each optimal assignment, where assignment[row] is the 
+ * column of the row. Returns whether to go on to the next one
+ */
+typedef bool (*AssignmentVisit)(void *arg, const int *assignment);
+
+/**
+ * Finds the assignments of a different column to each of the n rows
+ * whose total cost is as small as possible, where cost[row * n + col] is
+ * the cost of giving row its column. The Hungarian algorithm, O(n^3).
+ *
+ * Every optimal assignment is then passed to visit, in the order Heap's
+ * algorithm reaches them when it permutes the array `start` (start[row]
+ * is a column), until visit returns false. Costs within a tiny tolerance
+ * count as equal, so the caller can compare the tied assignments with
+ * the same sums as a search over every permutation.
+ */
+void AssignmentSolve(const double *cost, int n, const int *start,
+                     AssignmentVisit visit, void *arg);
+
+/**
+ * Applies to a[0 .. m - 1] the overall effect of running Heap's 
+ * algorithm on it, without visiting the permutations in between.
+ */
+void AssignmentHeapSkip(int *a, int m);
+
+#endif
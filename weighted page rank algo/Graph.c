@@ -1,147 +1,384 @@
-// from COMP2521 w8 lab code with some modification
-// Adjacency Matrix Representation - directed 
-
-// Written by: Bianca Ren
-// Date: 7th Nov 2022
-
-#include <assert.h>
-#include <stdbool.h>
-#include <stdio.h>
-#include <stdlib.h>
-
-#include "Graph.h"
-
-struct graph {
-    int **edges;   
-    int nV;     
-    int nE;
-    int col;      
-};
-
-void GraphShow(Graph g) {
-    int i, j;
-
-    printf("Number of vertices: %d\n", g->nV);
-    printf("Number of columns: %d\n", g->col);
-    printf("Number of edges: %d\n", g->nE);
-    printf("   |");
-
-    for (i = 0; i < g->col; i++) {
-        printf("%d | ", i);
-    }
-
-    printf("\n-------------------------------\n");
-
-    for (i = 0; i < g->nV; i++) {
-        for (j = 0; j < g->col; j++) {
-            if (j == 0) {
-                printf("%d | ", i);
-            }
-         
-            if (g->edges[i][j]) {
-                printf("%d | ", g->edges[i][j]);
-            } else {
-                printf("  | ");
-            }
-        
-        }
-        printf("\n-------------------------------\n");
-    }
-    
-    printf("\n");
-}
-
-Graph GraphNew(int row, int col) {
-    assert(row > 0);
-
-    int nV = row;
-
-    Graph g = malloc(sizeof(*g));
-    if (g == NULL) {
-        fprintf(stderr, "error: out of memory\n");
-        exit(EXIT_FAILURE);
-    }
-
-    g->nV = nV;
-    g->nE = 0;
-    g->col = col;
-
-    g->edges = malloc(nV * sizeof(int *));
-    if (g->edges == NULL) {
-        fprintf(stderr, "error: out of memory\n");
-        exit(EXIT_FAILURE);
-    }
-
-    for (int i = 0; i < nV; i++) {
-        g->edges[i] = calloc(col, sizeof(int));
-        if (g->edges[i] == NULL) {
-            fprintf(stderr, "error: out of memory\n");
-            exit(EXIT_FAILURE);
-        }
-    }
-
-    return g;
-}
-
-void GraphFree(Graph g) {
-    for (int i = 0; i < g->nV; i++) {
-        free(g->edges[i]);
-    }
-
-    free(g->edges);
-    free(g);
-}
-
-int GraphNumVertices(Graph g) {
-    return g->nV;
-}
-
-bool GraphInsertEdge(Graph g, urlNum src, urlNum dest) {
-    if (g->edges[src][dest] == 0) {
-        g->edges[src][dest] = 1;
-        g->nE++;
-        return true;
-    } else {
-        return false;
-    }
-}
-
-bool GraphRemoveEdge(Graph g, urlNum v, urlNum w) {
-    if (g->edges[v][w] != 0.0) {   // edge e in graph
-        g->edges[v][w] = 0.0;
-        g->nE--;
-        return true;
-    } else {
-        return false;
-    }
-}
-
-int GraphIsAdjacent(Graph g, urlNum v, urlNum w) {
-    return g->edges[v][w];
-}
-
-int edgeValue(Graph directUrl, int x, int y) {
-    return directUrl->edges[x][y];
-}
-
-int numOfOutLinks(Graph directUrl, int currUrl) {
-    int numOutL = 0;
-    for (int nextUrl = 0; nextUrl < GraphNumVertices(directUrl); nextUrl++) {
-        if (edgeValue(directUrl, currUrl, nextUrl)) {
-            numOutL++;
-        }
-    }
-
-    return numOutL;
-}
-
-int numMatchingTerms(Graph invertedIndex, int url) {
-    int numMatch = 0;
-    for (int i = 0; i < invertedIndex->nV; i++) {
-        if (invertedIndex->edges[i][url] == 1) {
-            numMatch++;
-        }
-    }
-
-    return numMatch;
-}
+// from COMP2521 w8 lab code with some modification
+// Compressed Sparse Row Representation - directed 
+
+// Written by: Bianca Ren
+// Date: 7th Nov 2022
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Graph.h"
+
+struct graph {
+    int nV;     
+    int nE;
+    int col;      
+    bool frozen;
+
+    // build phase: a growable list of destinations for each row
+    int **rows;
+    int *rowSize;
+    int *rowCap;
+
+    // build phase: column w is in row stampRow exactly when
+    // seen[w] == stamp, so a row's edges are checked in O(1) while
+    // they are inserted together
+    int *seen;
+    int stamp;
+    int stampRow;
+
+    // frozen phase: row v owns target[offset[v] .. offset[v + 1] - 1]
+    int *offset;
+    int *target;
+
+    // frozen phase, transposed: column w owns
+    // source[inOffset[w] .. inOffset[w + 1] - 1]
+    int *inOffset;
+    int *source;
+    int *inDegree;
+    int *outDegree;
+};
+
+/*
+ * Exit when the allocation failed
+ */
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static int compareInt(const void *a, const void *b) {
+    int x = *(const int *) a;
+    int y = *(const int *) b;
+
+    return (x > y) - (x < y);
+}
+
+void GraphShow(Graph g) {
+    int i, j;
+
+    printf("Number of vertices: %d\n", g->nV);
+    printf("Number of columns: %d\n", g->col);
+    printf("Number of edges: %d\n", g->nE);
+    printf("   |");
+
+    for (i = 0; i < g->col; i++) {
+        printf("%d | ", i);
+    }
+
+    printf("\n-------------------------------\n");
+
+    for (i = 0; i < g->nV; i++) {
+        for (j = 0; j < g->col; j++) {
+            if (j == 0) {
+                printf("%d | ", i);
+            }
+         
+            if (edgeValue(g, i, j)) {
+                printf("%d | ", edgeValue(g, i, j));
+            } else {
+                printf("  | ");
+            }
+        
+        }
+        printf("\n-------------------------------\n");
+    }
+    
+    printf("\n");
+}
+
+Graph GraphNew(int row, int col) {
+    assert(row > 0);
+
+    int nV = row;
+
+    Graph g = checkAlloc(malloc(sizeof(*g)));
+
+    g->nV = nV;
+    g->nE = 0;
+    g->col = col;
+    g->frozen = false;
+
+    g->rows = checkAlloc(calloc(nV, sizeof(int *)));
+    g->rowSize = checkAlloc(calloc(nV, sizeof(int)));
+    g->rowCap = checkAlloc(calloc(nV, sizeof(int)));
+    g->seen = checkAlloc(calloc(col > 0 ? col : 1, sizeof(int)));
+    g->stamp = 0;
+    g->stampRow = -1;
+
+    g->offset = NULL;
+    g->target = NULL;
+    g->inOffset = NULL;
+    g->source = NULL;
+    g->inDegree = NULL;
+    g->outDegree = NULL;
+
+    return g;
+}
+
+/*
+ * Release the per-row lists used while the graph was being built
+ */
+static void freeBuildRows(Graph g) {
+    for (int i = 0; i < g->nV; i++) {
+        free(g->rows[i]);
+    }
+
+    free(g->rows);
+    free(g->rowSize);
+    free(g->rowCap);
+    free(g->seen);
+
+    g->rows = NULL;
+    g->rowSize = NULL;
+    g->rowCap = NULL;
+    g->seen = NULL;
+}
+
+void GraphFree(Graph g) {
+    if (!g->frozen) {
+        freeBuildRows(g);
+    }
+
+    free(g->offset);
+    free(g->target);
+    free(g->inOffset);
+    free(g->source);
+    free(g->inDegree);
+    free(g->outDegree);
+    free(g);
+}
+
+/*
+ * Build the transposed (in-adjacency) arrays and the cached degrees from
+ * the packed rows. Rows are visited in order, so the sources of every
+ * column come out sorted.
+ */
+static void buildInLinks(Graph g) {
+    g->outDegree = checkAlloc(malloc(g->nV * sizeof(int)));
+    g->inDegree = checkAlloc(calloc(g->col > 0 ? g->col : 1, sizeof(int)));
+    g->inOffset = checkAlloc(malloc((g->col + 1) * sizeof(int)));
+    g->source = checkAlloc(malloc((g->nE > 0 ? g->nE : 1) * sizeof(int)));
+
+    for (int v = 0; v < g->nV; v++) {
+        g->outDegree[v] = g->offset[v + 1] - g->offset[v];
+        for (int e = g->offset[v]; e < g->offset[v + 1]; e++) {
+            g->inDegree[g->target[e]]++;
+        }
+    }
+
+    g->inOffset[0] = 0;
+    for (int w = 0; w < g->col; w++) {
+        g->inOffset[w + 1] = g->inOffset[w] + g->inDegree[w];
+    }
+
+    // the next free slot of each column
+    int *next = checkAlloc(malloc((g->col > 0 ? g->col : 1) * sizeof(int)));
+    for (int w = 0; w < g->col; w++) {
+        next[w] = g->inOffset[w];
+    }
+
+    for (int v = 0; v < g->nV; v++) {
+        for (int e = g->offset[v]; e < g->offset[v + 1]; e++) {
+            g->source[next[g->target[e]]++] = v;
+        }
+    }
+
+    free(next);
+}
+
+void GraphFreeze(Graph g) {
+    if (g->frozen) {
+        return;
+    }
+
+    g->offset = checkAlloc(malloc((g->nV + 1) * sizeof(int)));
+    // keep a valid pointer for an edgeless graph
+    g->target = checkAlloc(malloc((g->nE > 0 ? g->nE : 1) * sizeof(int)));
+
+    int e = 0;
+    for (int v = 0; v < g->nV; v++) {
+        g->offset[v] = e;
+        for (int i = 0; i < g->rowSize[v]; i++) {
+            g->target[e++] = g->rows[v][i];
+        }
+
+        qsort(g->target + g->offset[v], g->rowSize[v], sizeof(int),
+              compareInt);
+    }
+    g->offset[g->nV] = e;
+
+    freeBuildRows(g);
+    buildInLinks(g);
+    g->frozen = true;
+}
+
+int GraphNumVertices(Graph g) {
+    return g->nV;
+}
+
+/*
+ * Return the position of w in the targets of row v, or -1 if there is
+ * no such edge. Frozen rows are sorted so they can be binary searched.
+ */
+static int findEdge(Graph g, urlNum v, urlNum w) {
+    if (!g->frozen) {
+        for (int i = 0; i < g->rowSize[v]; i++) {
+            if (g->rows[v][i] == w) {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    int lo = g->offset[v];
+    int hi = g->offset[v + 1] - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (g->target[mid] == w) {
+            return mid;
+        } else if (g->target[mid] < w) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Make src the row that seen describes. A new stamp forgets the previous
+ * row, so switching costs the size of src's row, once for each run of 
+ * inserts into it
+ */
+static void restamp(Graph g, urlNum src) {
+    if (g->stampRow == src) {
+        return;
+    }
+
+    g->stamp++;
+    g->stampRow = src;
+    for (int i = 0; i < g->rowSize[src]; i++) {
+        g->seen[g->rows[src][i]] = g->stamp;
+    }
+}
+
+bool GraphInsertEdge(Graph g, urlNum src, urlNum dest) {
+    assert(!g->frozen);
+    assert(src >= 0 && src < g->nV);
+    assert(dest >= 0 && dest < g->col);
+
+    restamp(g, src);
+    if (g->seen[dest] == g->stamp) {
+        return false;
+    }
+    g->seen[dest] = g->stamp;
+
+    if (g->rowSize[src] == g->rowCap[src]) {
+        g->rowCap[src] = g->rowCap[src] == 0 ? 4 : g->rowCap[src] * 2;
+        g->rows[src] = checkAlloc(realloc(g->rows[src],
+                                          g->rowCap[src] * sizeof(int)));
+    }
+
+    g->rows[src][g->rowSize[src]++] = dest;
+    g->nE++;
+    return true;
+}
+
+bool GraphRemoveEdge(Graph g, urlNum v, urlNum w) {
+    assert(!g->frozen);
+
+    int i = findEdge(g, v, w);
+    if (i == -1) {
+        return false;
+    }
+
+    if (v == g->stampRow) {
+        g->seen[w] = 0;
+    }
+
+    // order inside a row is only fixed when the graph is frozen
+    g->rows[v][i] = g->rows[v][--g->rowSize[v]];
+    g->nE--;
+    return true;
+}
+
+int GraphIsAdjacent(Graph g, urlNum v, urlNum w) {
+    return findEdge(g, v, w) != -1;
+}
+
+int edgeValue(Graph directUrl, int x, int y) {
+    return GraphIsAdjacent(directUrl, x, y);
+}
+
+int numOfOutLinks(Graph directUrl, int currUrl) {
+    if (!directUrl->frozen) {
+        return directUrl->rowSize[currUrl];
+    }
+
+    return directUrl->outDegree[currUrl];
+}
+
+int numMatchingTerms(Graph invertedIndex, int url) {
+    if (invertedIndex->frozen) {
+        return invertedIndex->inDegree[url];
+    }
+
+    int numMatch = 0;
+    for (int i = 0; i < invertedIndex->nV; i++) {
+        if (GraphIsAdjacent(invertedIndex, i, url)) {
+            numMatch++;
+        }
+    }
+
+    return numMatch;
+}
+
+int GraphInDegree(Graph g, urlNum v) {
+    assert(g->frozen);
+    return g->inDegree[v];
+}
+
+int GraphOutDegree(Graph g, urlNum v) {
+    assert(g->frozen);
+    return g->outDegree[v];
+}
+
+const urlNum *GraphInLinks(Graph g, urlNum v, int *numLinks) {
+    assert(g->frozen);
+    *numLinks = g->inDegree[v];
+    return g->source + g->inOffset[v];
+}
+
+int GraphInOffset(Graph g, urlNum v) {
+    assert(g->frozen);
+    return g->inOffset[v];
+}
+
+int GraphNumEdges(Graph g) {
+    return g->nE;
+}
+
+const int *GraphInOffsets(Graph g) {
+    assert(g->frozen);
+    return g->inOffset;
+}
+
+const urlNum *GraphInSources(Graph g) {
+    assert(g->frozen);
+    return g->source;
+}
+
+const urlNum *GraphOutLinks(Graph g, urlNum v, int *numLinks) {
+    assert(g->frozen);
+    *numLinks = g->outDegree[v];
+    return g->target + g->offset[v];
+}
@@ -1,5 +1,5 @@
 // from COMP2521 w8 lab code with some modification
-// Adjacency Matrix Representation - directed 
+// Compressed Sparse Row Representation - directed 
 
 // written by Bianca Ren
 // Date: 7th Nov 2022
@@ -14,7 +14,9 @@ typedef struct graph *Graph;
 typedef int urlNum;
 
 /**
- * Creates a new instance of a graph
+ * Creates a new instance of a graph with `row` source vertices and
+ * `col` possible destinations. The graph starts in its build phase:
+ * edges are collected per row until GraphFreeze is called.
  */
 Graph GraphNew(int row, int col);
 
@@ -23,6 +25,14 @@ Graph GraphNew(int row, int col);
  */
 void GraphFree(Graph g);
 
+/**
+ * Ends the build phase. The collected edges are packed into an offset
+ * array and a target array (sorted within each row), so memory grows
+ * with the number of edges rather than with row * col.
+ * Edges can no longer be inserted or removed afterwards.
+ */
+void GraphFreeze(Graph g);
+
 /**
  * Returns the number of vertices in the graph
  */
@@ -31,13 +41,13 @@ int GraphNumVertices(Graph g);
 /**
  * Inserts  an  edge into a graph. Does nothing if there is already an
  * edge between `e.v` and `e.w`. Returns true if successful, and false
- * if there was already an edge.
+ * if there was already an edge. Only valid before GraphFreeze.
   */
 bool GraphInsertEdge(Graph g, urlNum src, urlNum dest);
 
 /**
  * Removes an edge from a graph. Returns true if successful, and false
- * if the edge did not exist.
+ * if the edge did not exist. Only valid before GraphFreeze.
  */
 bool GraphRemoveEdge(Graph g, urlNum v, urlNum w);
 
@@ -67,4 +77,42 @@ int numOfOutLinks(Graph directUrl, int currUrl);
  */
 int numMatchingTerms(Graph invertedIndex, int url);
 
+/*
+ * Cached number of edges pointing into / out of the given vertex.
+ * Only valid after GraphFreeze.
+ */
+int GraphInDegree(Graph g, urlNum v);
+int GraphOutDegree(Graph g, urlNum v);
+
+/*
+ * Return the sources of every edge into v (the transposed, in-adjacency
+ * view) in increasing order, and store how many there are in numLinks.
+ * The array belongs to the graph. Only valid after GraphFreeze.
+ */
+const urlNum *GraphInLinks(Graph g, urlNum v, int *numLinks);
+
+/*
+ * Edges into v occupy the in-edge slots GraphInOffset(g, v) up to
+ * GraphInOffset(g, v) + GraphInDegree(g, v) - 1, in the same order as
+ * GraphInLinks. Slots run from 0 to GraphNumEdges(g) - 1, so callers can
+ * keep per-edge data in a plain array. Only valid after GraphFreeze.
+ */
+int GraphInOffset(Graph g, urlNum v);
+int GraphNumEdges(Graph g);
+
+/*
+ * The whole in-adjacency at once, for loops over every vertex: the 
+ * sources of the edges into v are GraphInSources(g)[o[v] .. o[v + 1] - 1]
+ * with o = GraphInOffsets(g). Only valid after GraphFreeze.
+ */
+const int *GraphInOffsets(Graph g);
+const urlNum *GraphInSources(Graph g);
+
+/*
+ * Return the destinations of every edge out of v in increasing order,
+ * and store how many there are in numLinks. The array belongs to the
+ * graph. Only valid after GraphFreeze.
+ */
+const urlNum *GraphOutLinks(Graph g, urlNum v, int *numLinks);
+
 #endif
@@ -0,0 +1,461 @@
+// Index.c - Implementation of the binary inverted index
+//
+// The layout is one block that is either built in memory or mapped from
+// a file:
+//     header, with a stamp of the files the index was compiled from
+//     term dictionary, sorted by term (binary searched)
+//     term names, nul-terminated, back to back
+//     postings: per term, the ascending url ids as LEB128 varints of the
+//               gap to the previous id
+
+// Written by: Bianca Ren
+// Date: 13rd Nov 2022
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Index.h"
+#include "Reader.h"
+#include "Sort.h"
+#include "UrlTable.h"
+
+#define INDEX_MAGIC "WPRIDX3"
+
+struct indexHeader {
+    char magic[8];
+    uint32_t numUrls;
+    uint32_t numTerms;
+    uint64_t sources;       // stamp of the files compiled from
+    uint64_t termsOffset;
+    uint64_t namesOffset;
+    uint64_t postingsOffset;
+    uint64_t size;
+};
+
+struct termEntry {
+    uint64_t postings;      // offset from the start of the postings
+    uint32_t name;          // offset from the start of the names
+    uint32_t numPostings;
+};
+
+struct indexRep {
+    unsigned char *data;
+    size_t size;
+    bool mapped;
+
+    const struct indexHeader *header;
+    const struct termEntry *terms;
+    const char *names;
+    const unsigned char *postings;
+    uint64_t namesSize;
+    uint64_t postingsSize;
+};
+
+// postings of one term while compiling
+struct postingList {
+    int *urls;
+    int size;
+    int cap;
+};
+
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static int compareInt(const void *a, const void *b) {
+    int x = *(const int *) a;
+    int y = *(const int *) b;
+
+    return (x > y) - (x < y);
+}
+
+static void addPosting(struct postingList *p, int url) {
+    if (p->size == p->cap) {
+        p->cap = p->cap == 0 ? 4 : p->cap * 2;
+        p->urls = checkAlloc(realloc(p->urls, p->cap * sizeof(int)));
+    }
+
+    p->urls[p->size++] = url;
+}
+
+/*
+ * Sort the postings and drop repeated urls
+ */
+static void tidyPostings(struct postingList *p) {
+    qsort(p->urls, p->size, sizeof(int), compareInt);
+
+    int n = 0;
+    for (int i = 0; i < p->size; i++) {
+        if (n == 0 || p->urls[i] != p->urls[n - 1]) {
+            p->urls[n++] = p->urls[i];
+        }
+    }
+    p->size = n;
+}
+
+static size_t writeVarint(unsigned char *out, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    out[n++] = value;
+
+    return n;
+}
+
+static size_t varintSize(uint32_t value) {
+    size_t n = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        n++;
+    }
+
+    return n;
+}
+
+/*
+ * Point the section pointers into the block
+ */
+static Index wrapBlock(unsigned char *data, size_t size, bool mapped) {
+    Index idx = checkAlloc(malloc(sizeof(*idx)));
+
+    idx->data = data;
+    idx->size = size;
+    idx->mapped = mapped;
+    idx->header = (const struct indexHeader *) data;
+    idx->terms = (const struct termEntry *) 
+                 (data + idx->header->termsOffset);
+    idx->names = (const char *) (data + idx->header->namesOffset);
+    idx->postings = data + idx->header->postingsOffset;
+    idx->namesSize = idx->header->postingsOffset - idx->header->namesOffset;
+    idx->postingsSize = size - idx->header->postingsOffset;
+
+    return idx;
+}
+
+/*
+ * Lay the terms out in the binary format, in alphabetical order
+ */
+static Index buildBlock(UrlTable terms, struct postingList *lists, 
+                        List pageRankL, uint64_t sources) {
+    int numTerms = UrlTableSize(terms);
+    const char **names = checkAlloc(malloc((numTerms > 0 ? numTerms : 1) 
+                                           * sizeof(char *)));
+    int *order = checkAlloc(malloc((numTerms > 0 ? numTerms : 1) 
+                                   * sizeof(int)));
+
+    size_t namesSize = 0;
+    size_t postingsSize = 0;
+    for (int t = 0; t < numTerms; t++) {
+        names[t] = UrlTableName(terms, t);
+        namesSize += UrlTableNameLength(terms, t) + 1;
+
+        tidyPostings(&lists[t]);
+        int prev = 0;
+        for (int i = 0; i < lists[t].size; i++) {
+            postingsSize += varintSize(lists[t].urls[i] - prev);
+            prev = lists[t].urls[i];
+        }
+    }
+
+    int *lexRank = SortLexicalRanks(names, numTerms);
+    for (int t = 0; t < numTerms; t++) {
+        order[lexRank[t]] = t;
+    }
+
+    struct indexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.numUrls = ListLength(pageRankL);
+    header.numTerms = numTerms;
+    header.sources = sources;
+    header.termsOffset = sizeof(header);
+    header.namesOffset = header.termsOffset 
+                         + (uint64_t) numTerms * sizeof(struct termEntry);
+    header.postingsOffset = header.namesOffset + namesSize;
+    header.size = header.postingsOffset + postingsSize;
+
+    unsigned char *data = checkAlloc(calloc(header.size, 1));
+    memcpy(data, &header, sizeof(header));
+
+    struct termEntry *entries = (struct termEntry *) 
+                                (data + header.termsOffset);
+    char *nameOut = (char *) (data + header.namesOffset);
+    unsigned char *postingOut = data + header.postingsOffset;
+    size_t nameAt = 0;
+    size_t postingAt = 0;
+
+    for (int i = 0; i < numTerms; i++) {
+        int t = order[i];
+        int len = UrlTableNameLength(terms, t);
+
+        entries[i].name = nameAt;
+        entries[i].postings = postingAt;
+        entries[i].numPostings = lists[t].size;
+
+        memcpy(nameOut + nameAt, names[t], len + 1);
+        nameAt += len + 1;
+
+        int prev = 0;
+        for (int j = 0; j < lists[t].size; j++) {
+            postingAt += writeVarint(postingOut + postingAt, 
+                                     lists[t].urls[j] - prev);
+            prev = lists[t].urls[j];
+        }
+    }
+
+    free(lexRank);
+    free(order);
+    free(names);
+
+    return wrapBlock(data, header.size, false);
+}
+
+Index IndexCompile(List pageRankL, const char *textPath, uint64_t sources) {
+    Reader r = ReaderOpen(textPath);
+    if (r == NULL) {
+        fprintf(stderr, "Can't open %s\n", textPath);
+        exit(EXIT_FAILURE);
+    }
+
+    UrlTable terms = UrlTableNew();
+    struct postingList *lists = NULL;
+    int cap = 0;
+    int term = -1;
+    Span token;
+
+    // a token that is a url belongs to the current term, anything else 
+    // starts a new term
+    while (ReaderToken(r, &token)) {
+        int url = ListLookup(pageRankL, token.start, token.len);
+        if (url < ListLength(pageRankL) && term != -1) {
+            addPosting(&lists[term], url);
+            continue;
+        }
+
+        term = UrlTableIntern(terms, token.start, token.len);
+        if (term == cap) {
+            cap = cap == 0 ? 64 : cap * 2;
+            lists = checkAlloc(realloc(lists, cap * sizeof(*lists)));
+            memset(lists + term, 0, (cap - term) * sizeof(*lists));
+        }
+    }
+
+    ReaderClose(r);
+
+    Index idx = buildBlock(terms, lists, pageRankL, sources);
+
+    for (int t = 0; t < UrlTableSize(terms); t++) {
+        free(lists[t].urls);
+    }
+    free(lists);
+    UrlTableFree(terms);
+
+    return idx;
+}
+
+bool IndexWrite(Index idx, const char *binPath) {
+    FILE *fp = fopen(binPath, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    bool ok = fwrite(idx->data, 1, idx->size, fp) == idx->size;
+    return fclose(fp) == 0 && ok;
+}
+
+/*
+ * Read one varint that must end before end. Returns NULL if it doesn't
+ * or is too long for a url id
+ */
+static const unsigned char *readVarint(const unsigned char *p, 
+                                       const unsigned char *end,
+                                       uint32_t *value) {
+    uint32_t v = 0;
+    for (int shift = 0; p < end && shift < 35; shift += 7) {
+        v |= (uint32_t) (*p & 0x7f) << shift;
+        if ((*p++ & 0x80) == 0) {
+            *value = v;
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Check that the sections lie inside the file in order, and that the 
+ * names end in a nul so no name runs off the end. Terms and postings
+ * are checked as they are used
+ */
+static bool validSections(const unsigned char *data, size_t size) {
+    const struct indexHeader *h = (const void *) data;
+    uint64_t n = h->numTerms;
+    if (
+        h->size != size ||
+        h->termsOffset % 8 != 0 || h->termsOffset < sizeof(*h) ||
+        h->termsOffset > size ||
+        n > (size - h->termsOffset) / sizeof(struct termEntry) ||
+        h->namesOffset < h->termsOffset + n * sizeof(struct termEntry) ||
+        h->postingsOffset < h->namesOffset || h->postingsOffset > size
+    ) {
+        return false;
+    }
+
+    uint64_t namesSize = h->postingsOffset - h->namesOffset;
+    return namesSize == 0 || data[h->postingsOffset - 1] == '\0';
+}
+
+/*
+ * Check that the postings of term t lie inside the file, where the next
+ * term's start, and that its url ids go up and stay below numUrls
+ */
+static bool validPostings(Index idx, uint32_t t) {
+    const struct termEntry *term = &idx->terms[t];
+    uint64_t end = t + 1 < idx->header->numTerms ? term[1].postings 
+                                                 : idx->postingsSize;
+    if (term->postings > end || end > idx->postingsSize) {
+        return false;
+    }
+
+    const unsigned char *p = idx->postings + term->postings;
+    uint32_t numUrls = idx->header->numUrls;
+    uint32_t url = 0;
+    for (uint32_t i = 0; i < term->numPostings; i++) {
+        uint32_t gap = 0;
+        p = readVarint(p, idx->postings + end, &gap);
+        if (p == NULL || (i > 0 && gap == 0) || gap >= numUrls - url) {
+            return false;
+        }
+        url += gap;
+    }
+
+    return true;
+}
+
+Index IndexOpen(const char *binPath, List pageRankL, uint64_t sources) {
+    int fd = open(binPath, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (
+        fstat(fd, &st) == -1 || 
+        st.st_size < (off_t) sizeof(struct indexHeader)
+    ) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    const struct indexHeader *header = data;
+    if (
+        memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        header->numUrls != (uint32_t) ListLength(pageRankL) ||
+        header->sources != sources ||
+        !validSections(data, st.st_size)
+    ) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    return wrapBlock(data, st.st_size, true);
+}
+
+bool IndexCheck(Index idx) {
+    const struct termEntry *terms = idx->terms;
+    for (uint32_t t = 0; t < idx->header->numTerms; t++) {
+        if (
+            terms[t].name >= idx->namesSize || !validPostings(idx, t) ||
+            (t > 0 && strcmp(idx->names + terms[t - 1].name, 
+                             idx->names + terms[t].name) >= 0)
+        ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void IndexFree(Index idx) {
+    if (idx->mapped) {
+        munmap(idx->data, idx->size);
+    } else {
+        free(idx->data);
+    }
+
+    free(idx);
+}
+
+/*
+ * Binary search the dictionary. Returns the entry's number, -1 if the 
+ * term isn't there, or -2 if a name offset it passed is out of range
+ */
+static int64_t findTerm(Index idx, const char *term) {
+    int64_t lo = 0;
+    int64_t hi = (int64_t) idx->header->numTerms - 1;
+
+    while (lo <= hi) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (idx->terms[mid].name >= idx->namesSize) {
+            return -2;
+        }
+
+        int cmp = strcmp(idx->names + idx->terms[mid].name, term);
+        if (cmp == 0) {
+            return mid;
+        } else if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+int IndexMatch(Index idx, const char *term, int *matches) {
+    int64_t t = findTerm(idx, term);
+    if (t == -1) {
+        return 0;
+    } else if (t < 0 || !validPostings(idx, t)) {
+        return -1;
+    }
+
+    const struct termEntry *entry = &idx->terms[t];
+    const unsigned char *p = idx->postings + entry->postings;
+    const unsigned char *end = idx->postings + idx->postingsSize;
+    uint32_t url = 0;
+    for (uint32_t i = 0; i < entry->numPostings; i++) {
+        uint32_t gap = 0;
+        p = readVarint(p, end, &gap);
+
+        url += gap;
+        matches[url]++;
+    }
+
+    return entry->numPostings;
+}
+
+int IndexNumTerms(Index idx) {
+    return idx->header->numTerms;
+}
@@ -0,0 +1,66 @@
+// Index.h - Interface to the binary inverted index
+
+// Written by: Bianca Ren
+// Date: 13rd Nov 2022
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "List.h"
+
+// file searchPageRank compiles invertedIndex.txt into
+#define INDEX_FILE "./invertedIndex.bin"
+
+typedef struct indexRep *Index;
+
+/**
+ * Reads a text inverted index (lines of a term followed by its urls) and
+ * compiles it into the binary layout, kept in memory. Url ids are the
+ * positions of the urls in pageRankL; urls that aren't in it end a line.
+ * `sources` is a stamp of the files it was compiled from, kept in the 
+ * header for IndexOpen. Exits if the text file can't be read.
+ */
+Index IndexCompile(List pageRankL, const char *textPath, uint64_t sources);
+
+/**
+ * Writes a compiled index to the given file. Returns false on failure.
+ */
+bool IndexWrite(Index idx, const char *binPath);
+
+/**
+ * Maps a binary index file into memory. Returns NULL if the file can't
+ * be opened, its sections don't fit in it, or it was compiled from files
+ * with a different stamp or for a different number of urls. Only the
+ * header is read, so opening costs the same for any size of index.
+ */
+Index IndexOpen(const char *binPath, List pageRankL, uint64_t sources);
+
+/**
+ * Checks every term and posting of the index, for a caller that will 
+ * match many queries against it. Returns false if any is damaged.
+ */
+bool IndexCheck(Index idx);
+
+/**
+ * Frees the index, unmapping the file if it was opened from one.
+ */
+void IndexFree(Index idx);
+
+/**
+ * Adds one to matches[url] for every url whose page contains the term.
+ * Only the postings of that term are read, and they are checked first.
+ * Returns the number of urls with the term, which is 0 if the term isn't
+ * in the index, or -1 (with matches unchanged) if the entries it read 
+ * are damaged.
+ */
+int IndexMatch(Index idx, const char *term, int *matches);
+
+/**
+ * Returns the number of distinct terms in the index.
+ */
+int IndexNumTerms(Index idx);
+
+#endif
@@ -13,30 +13,56 @@
 #include <string.h>
 
 #include "List.h"
+#include "Reader.h"
+#include "Sort.h"
+#include "UrlTable.h"
 
-// data structures representing List
-typedef struct node *Node;
+// data structures representing List: one array per field, indexed by
+// position. Names live in the UrlTable's arena and are reached through
+// the ids array.
+struct IntListRep {
+	int size;            
+	int cap;
 
-struct node {
-	char url[MAX_URL_LENGTH];
-	double weightedPR;
-	int outDegree;
+	int *ids;            // id of the url at each position
+	int *outDegree;
+	double *weightedPR;
 
-	Node next;  
+	UrlTable urls;       // interned names of every url in the list
+	int *firstPos;       // first position of each id
+	int *lexRank;        // alphabetical rank of each position, or NULL
 };
 
-struct IntListRep {
-	int size;            
-	Node first;          
-};
+/*
+ * Return the name of the url at the given position
+ */
+static const char *urlAt(List l, int position) {
+	return UrlTableName(l->urls, l->ids[position]);
+}
 
-static Node newListNode(char urlName[MAX_URL_LENGTH], 
-                        double weightedPR, int outDegree);
-/* 
- * Return true if given url are equal, otherwise return false
+/*
+ * Make room for at least n urls, doubling the arrays so that appending
+ * is amortised O(1)
  */
-static bool areSame(char url1[MAX_URL_LENGTH], char url2[MAX_URL_LENGTH]) {
-	return strcmp(url1, url2) == 0;
+static void reserve(List l, int n) {
+	if (n <= l->cap) {
+		return;
+	}
+
+	while (l->cap < n) {
+		l->cap = l->cap == 0 ? 16 : l->cap * 2;
+	}
+
+	l->ids = realloc(l->ids, l->cap * sizeof(int));
+	l->outDegree = realloc(l->outDegree, l->cap * sizeof(int));
+	l->weightedPR = realloc(l->weightedPR, l->cap * sizeof(double));
+	l->firstPos = realloc(l->firstPos, l->cap * sizeof(int));
+	if (
+		l->ids == NULL || l->outDegree == NULL || 
+		l->weightedPR == NULL || l->firstPos == NULL
+	) {
+		err(EX_OSERR, "couldn't allocate List");
+	}
 }
 
 List ListNew(void) {
@@ -46,85 +72,100 @@ List ListNew(void) {
 	}
 
 	l->size = 0;
-	l->first = NULL;
+	l->cap = 0;
+	l->ids = NULL;
+	l->outDegree = NULL;
+	l->weightedPR = NULL;
+	l->urls = UrlTableNew();
+	l->firstPos = NULL;
+	l->lexRank = NULL;
 
 	return l;
 }
 
 void ListFree(List l) {
-	Node curr = l->first;
-	while (curr != NULL) {
-		Node temp = curr;
-		curr = curr->next;
-		free(temp);
-	}
-
+	UrlTableFree(l->urls);
+	free(l->ids);
+	free(l->outDegree);
+	free(l->weightedPR);
+	free(l->firstPos);
+	free(l->lexRank);
 	free(l);
 }
 
 List urlsInList(void) {
-	List allUrls = ListNew();
-	char *urlName = malloc(sizeof(char) * MAX_URL_LENGTH);
-
-	FILE *fp = fopen("./collection.txt", "r");
-	if (fp == NULL) {
+	Reader r = ReaderOpen("./collection.txt");
+	if (r == NULL) {
 		fprintf(stderr, "Can't open ./collection.txt\n");
 		exit(EXIT_FAILURE);
 	}
 	
-	while (fscanf(fp, "%s ", urlName) == 1) {
-		ListAppend(allUrls, urlName);
-    }
-
-	fclose(fp);
-	free(urlName);
+	List allUrls = ListReadUrls(r);
+	ReaderClose(r);
 
 	return allUrls;
 }
 
-static Node appending(Node n, char urlName[MAX_URL_LENGTH]) {
-	if (n == NULL) {
-		return newListNode(urlName, 0, 0.0);
-    } 
+List ListReadUrls(Reader r) {
+	List allUrls = ListNew();
 
-    n->next = appending(n->next, urlName);
-    return n;
-}
+	Span urlName;
+	while (ReaderToken(r, &urlName)) {
+		ListAppendUrl(allUrls, urlName.start, urlName.len, 0, 0.0);
+	}
 
-void ListAppend(List l, char urlName[MAX_URL_LENGTH]) {
-	l->first = appending(l->first, urlName);
-	l->size++;
+	return allUrls;
 }
 
-static Node appendingWithAllInfo(Node n, char urlName[MAX_URL_LENGTH],
-							     int outDegree, double weightPR) {
-	if (n == NULL) {
-		return newListNode(urlName, weightPR, outDegree);
-    } 
+List ListFromRankTable(RankTable t) {
+	List l = ListNew();
+	int n = RankTableSize(t);
+	const int32_t *outDegree = RankTableOutDegrees(t);
+	const double *weightedPR = RankTableWeightedPRs(t);
 
-    n->next = appendingWithAllInfo(n->next, urlName, outDegree, weightPR);
-    return n;
+	reserve(l, n);
+	for (int i = 0; i < n; i++) {
+		const char *name = RankTableName(t, i);
+		ListAppendUrl(l, name, strlen(name), outDegree[i], weightedPR[i]);
+	}
+
+	l->lexRank = malloc((n > 0 ? n : 1) * sizeof(int));
+	if (l->lexRank == NULL) {
+		err(EX_OSERR, "couldn't allocate List");
+	}
+	memcpy(l->lexRank, RankTableLexRanks(t), n * sizeof(int));
+
+	return l;
+}
+
+void ListAppend(List l, char urlName[MAX_URL_LENGTH]) {
+	ListAppendWithAllInfo(l, urlName, 0, 0.0);
 }
 
 void ListAppendWithAllInfo(List l, char urlName[MAX_URL_LENGTH], 
 						   int outDegree, double weightPR) {
-	l->first = appendingWithAllInfo(l->first, urlName, outDegree, weightPR);
-	l->size++;
+	ListAppendUrl(l, urlName, strlen(urlName), outDegree, weightPR);
 }
 
-static Node newListNode(char urlName[MAX_URL_LENGTH], 
-                        double weightedPR, int outDegree) {
-	Node n = malloc(sizeof(*n));
-	if (n == NULL) {
-		err(EX_OSERR, "couldn't allocate List node");
+void ListAppendUrl(List l, const char *urlName, int len, int outDegree, 
+				   double weightPR) {
+	int numIds = UrlTableSize(l->urls);
+	int id = UrlTableIntern(l->urls, urlName, len);
+
+	reserve(l, l->size + 1);
+
+	free(l->lexRank);
+	l->lexRank = NULL;
+
+	// ids are handed out in order of first appearance
+	if (id == numIds) {
+		l->firstPos[id] = l->size;
 	}
-    
-	strcpy(n->url, urlName);
-	n->weightedPR = weightedPR;
-	n->outDegree = outDegree;
-	n->next = NULL;
 
-	return n;
+	l->ids[l->size] = id;
+	l->outDegree[l->size] = outDegree;
+	l->weightedPR[l->size] = weightPR;
+	l->size++;
 }
 
 int ListLength(List l) {
@@ -132,191 +173,211 @@ int ListLength(List l) {
 }
 
 char *getUrlName(List l, int order) {
-	Node n = l->first;
-	int i;
-
-	for (i = 0; i < order; i++) {
-		n = n->next;
-	}
-
-	return n->url;
+	return (char *) urlAt(l, order);
 }
 
 int getUrlNum(List l, char urlName[MAX_URL_LENGTH]) {
-	Node n = l->first;
+	return ListLookup(l, urlName, strlen(urlName));
+}
 
-	int i;
-	for (i = 0; i < ListLength(l); i++) {
-		if (areSame(n->url, urlName)) {
-			break;
-		}
+int ListLookup(List l, const char *urlName, int len) {
+	int id = UrlTableLookup(l->urls, urlName, len);
 
-		n = n->next;
+	return id == -1 ? ListLength(l) : l->firstPos[id];
+}
+
+void listShow(List l) {
+	for (int i = 0; i < l->size; i++) {
+		printf("%s %d %.7lf\n", urlAt(l, i), l->outDegree[i], 
+		       l->weightedPR[i]);
 	}
 
-	return i;
 }
 
-void listShow(List l) {
-	for (Node curr = l->first; curr != NULL; curr = curr->next) {
-		printf("%s %d %.7lf\n", curr->url, curr->outDegree, curr->weightedPR);
+bool ListWriteRankTable(List l, const char *path) {
+	const char **names = malloc((l->size > 0 ? l->size : 1) * sizeof(char *));
+	if (names == NULL) {
+		err(EX_OSERR, "couldn't allocate List names");
+	}
+
+	for (int i = 0; i < l->size; i++) {
+		names[i] = urlAt(l, i);
 	}
 
+	ListPrepareSort(l);
+	bool ok = RankTableWrite(path, l->size, names, l->outDegree, 
+	                         l->weightedPR, l->lexRank);
+	free(names);
+
+	return ok;
 }
 
 void updateWeightedPR(char url[MAX_URL_LENGTH], List l,
                                   double weightedPR) {
-	for (Node curr = l->first; curr != NULL; curr = curr->next) {
-		if (areSame(url, curr->url)) {
-			curr->weightedPR = weightedPR;
-			return;
-		}
+	int i = getUrlNum(l, url);
+	if (i < l->size) {
+		l->weightedPR[i] = weightedPR;
 	}
 }
 
+void ListSetWeightedPR(List l, const double *weightedPR) {
+	memcpy(l->weightedPR, weightedPR, l->size * sizeof(double));
+}
+
 void updateAllOutDegree(Graph directUrl, List l) {
-	int i = 0;
-	for (Node curr = l->first; curr != NULL; curr = curr->next) {
-		curr->outDegree = numOfOutLinks(directUrl, i++);
+	for (int i = 0; i < l->size; i++) {
+		l->outDegree[i] = numOfOutLinks(directUrl, i);
 	}
 }
 
 /*
- * Compare the weighted page rank and url name. 
- * Return true if n1 > n2, otherwise return false
+ * Append the url at position i of `from` to the end of `to`
+ */
+static void appendFrom(List to, List from, int i) {
+	ListAppendWithAllInfo(to, (char *) urlAt(from, i), from->outDegree[i],
+	                      from->weightedPR[i]);
+}
+
+/*
+ * Build the sort key of every page in the list. When the number of 
+ * matching terms of each page is given, only pages with at least one
+ * match get a key. Returns the number of keys
  */
-bool canInsert(Node n1, Node n2) {
-	if (n1->weightedPR > n2->weightedPR) {
-		return true;
-	} else if (n1->weightedPR < n2->weightedPR) {
-		return false;
+static int makeKeys(List l, const int *matches, RankKey *keys) {
+	ListPrepareSort(l);
+
+	int n = 0;
+	for (int i = 0; i < l->size; i++) {
+		if (matches != NULL && matches[i] == 0) {
+			continue;
+		}
+
+		keys[n].matches = matches == NULL ? 0 : matches[i];
+		keys[n].lexRank = l->lexRank[i];
+		keys[n].weightedPR = l->weightedPR[i];
+		keys[n].page = i;
+		n++;
 	}
 
-	return strcmp(n1->url, n2->url) < 0;
+	return n;
 }
 
-/*
- * Main process of sorting the given list in descending order by weighted page rank
-*/
-void doSortList(List sortedList, char url[MAX_URL_LENGTH], 
-				double weightedPR, int numOutL) {
-	Node newNode = newListNode(url, weightedPR, numOutL);
-	sortedList->size++;
-
-	if (sortedList->first == NULL) {
-		sortedList->first = newNode;
+void ListPrepareSort(List l) {
+	if (l->lexRank != NULL) {
 		return;
-	} else if (canInsert(newNode, sortedList->first)) {
-		newNode->next = sortedList->first;
-		sortedList->first = newNode;
+	}
 
-		return;
-	} 
-
-	for (Node curr = sortedList->first; curr != NULL; curr = curr->next) {
-		if (curr->next == NULL && canInsert(curr, newNode)) {
-			curr->next = newNode;
-		} else if (
-			canInsert(curr, newNode) && 
-			canInsert(newNode, curr->next) && 
-			curr->next != NULL
-		) {
-			newNode->next = curr->next;
-			curr->next = newNode;
-
-			return;
-		}
+	const char **names = malloc((l->size > 0 ? l->size : 1) * sizeof(char *));
+	if (names == NULL) {
+		err(EX_OSERR, "couldn't allocate List keys");
+	}
+
+	for (int i = 0; i < l->size; i++) {
+		names[i] = urlAt(l, i);
 	}
+
+	l->lexRank = SortLexicalRanks(names, l->size);
+	free(names);
 }
 
-List sortList(List l) {
+const int *ListLexRanks(List l) {
+	ListPrepareSort(l);
+
+	return l->lexRank;
+}
+
+/*
+ * Make a list of the pages the keys refer to, in the order of the keys
+ */
+static List listFromKeys(List l, const RankKey *keys, int n) {
 	List sortedList = ListNew();
 
-	for (Node curr = l->first; curr != NULL; curr = curr->next) {
-		doSortList(sortedList, curr->url, curr->weightedPR, curr->outDegree);
+	for (int i = 0; i < n; i++) {
+		appendFrom(sortedList, l, keys[i].page);
 	}
 
 	return sortedList;
 }
 
 /*
- * Compare the number of matches, weighted page rank and urlname
- * return true if it can be inserted
+ * Number of matching terms of every page in the list
  */
-bool insert(Node n1, Node n2, Graph invertedIndex, List originalL) {
-	int num1 = numMatchingTerms(invertedIndex, getUrlNum(originalL, n1->url));
-	int num2 = numMatchingTerms(invertedIndex, getUrlNum(originalL, n2->url));
-	
-	if (num1 > num2) {
-		return true;
-	} else if (num1 < num2) {
-		return false;
+static int *matchesOf(List l, Graph invertedIndex) {
+	int *matches = malloc((l->size > 0 ? l->size : 1) * sizeof(int));
+	if (matches == NULL) {
+		err(EX_OSERR, "couldn't allocate List keys");
 	}
 
-	if (n1->weightedPR > n2->weightedPR) {
-		return true;
-	} else if (n1->weightedPR < n2->weightedPR) {
-		return false;
+	for (int i = 0; i < l->size; i++) {
+		matches[i] = numMatchingTerms(invertedIndex, i);
 	}
 
-	return strcmp(n1->url, n2->url) < 0;
+	return matches;
 }
 
-/*
- * Main process of sorting the given list in descending order. 
- */
-void doSearchPRSort(List sortL, Node curr, 
-                    Graph invertedIndex, List originalL) {
-	if (numMatchingTerms(invertedIndex, getUrlNum(originalL, curr->url)) == 0) {
-		return;
+static RankKey *newKeys(List l) {
+	RankKey *keys = malloc((l->size > 0 ? l->size : 1) * sizeof(RankKey));
+	if (keys == NULL) {
+		err(EX_OSERR, "couldn't allocate List keys");
 	}
 
-	Node newNode = newListNode(curr->url, curr->weightedPR, curr->outDegree);
-	sortL->size++;
-
-	if (sortL->first == NULL) {
-		sortL->first = newNode;
-	} else if (insert(newNode, sortL->first, invertedIndex, originalL)) {
-		newNode->next = sortL->first;
-		sortL->first = newNode;
-	} else {
-		for (Node temp = sortL->first; temp != NULL; temp = temp->next) {
-			if (
-				temp->next == NULL && 
-				insert(temp, newNode, invertedIndex, originalL)
-			) {
-				temp->next = newNode;
-				break;
-			} else if (temp->next != NULL) {
-				bool result1 = insert(temp, newNode, invertedIndex, originalL);
-				bool result2 = insert(newNode, temp->next, invertedIndex, originalL);
-				
-				if (result1 && result2) {
-					newNode->next = temp->next;
-					temp->next = newNode;
-				}
-			}
-		}
-	}
+	return keys;
+}
+
+List sortList(List l) {
+	RankKey *keys = newKeys(l);
+	int n = makeKeys(l, NULL, keys);
+
+	SortByRank(keys, n);
+	List sortedList = listFromKeys(l, keys, n);
+
+	free(keys);
+
+	return sortedList;
 }
 
 List searchPRSort(List pageRankL, Graph invertedIndex) {
-	List sortedList = ListNew();
+	RankKey *keys = newKeys(pageRankL);
+	int *matches = matchesOf(pageRankL, invertedIndex);
+	int n = makeKeys(pageRankL, matches, keys);
+
+	SortByRank(keys, n);
+	List sortedList = listFromKeys(pageRankL, keys, n);
 
-	for (Node curr = pageRankL->first; curr != NULL; curr = curr->next) {
-		doSearchPRSort(sortedList, curr, invertedIndex, pageRankL);
+	free(matches);
+	free(keys);
+
+	return sortedList;
+}
+
+List searchPRTopK(List pageRankL, Graph invertedIndex, int k) {
+	int *matches = matchesOf(pageRankL, invertedIndex);
+	List sortedList = searchPRTopKMatches(pageRankL, matches, k);
+
+	free(matches);
+
+	return sortedList;
+}
+
+List searchPRTopKMatches(List pageRankL, const int *matches, int k) {
+	RankKey *keys = newKeys(pageRankL);
+	RankKey *best = malloc((k > 0 ? k : 1) * sizeof(RankKey));
+	if (best == NULL) {
+		err(EX_OSERR, "couldn't allocate List keys");
 	}
 
+	int n = makeKeys(pageRankL, matches, keys);
+	n = SortTopK(keys, n, k, best);
+	List sortedList = listFromKeys(pageRankL, best, n);
+
+	free(keys);
+	free(best);
+
 	return sortedList;
 }
 
 void searchPRShow(List sorted) {
-	int i = 0;
-	for (Node curr = sorted->first; curr != NULL; curr = curr->next) {
-		printf("%s\n", curr->url);
-		
-		if (i++ == 29) {
-			break;
-		}
+	for (int i = 0; i < sorted->size && i < SEARCH_RESULTS; i++) {
+		printf("%s\n", urlAt(sorted, i));
 	}
-}
\ No newline at end of file
+}
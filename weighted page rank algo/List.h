@@ -11,9 +11,13 @@
 #include <stdio.h>
 
 #include "Graph.h"
+#include "RankTable.h"
+#include "Reader.h"
 
 // 4 characters are for '.txt'
 #define MAX_URL_LENGTH 104
+// number of pages shown for a search
+#define SEARCH_RESULTS 30
 
 typedef struct IntListRep *List;
 
@@ -33,6 +37,18 @@ void ListFree(List l);
  */
 List urlsInList(void);
 
+/**
+ * Creates an List of all the urls the reader has left
+ */
+List ListReadUrls(Reader r);
+
+/**
+ * Creates an List of the pages of a rank table, in rank order. The
+ * alphabetical order comes from the table too, so nothing is parsed
+ * or sorted.
+ */
+List ListFromRankTable(RankTable t);
+
 /**
  * Appends an integer to an List.
  */
@@ -44,6 +60,13 @@ void ListAppend(List l, char urlName[MAX_URL_LENGTH]);
 void ListAppendWithAllInfo(List l, char urlName[MAX_URL_LENGTH], 
 						   int outDegree, double weightPR);
 
+/**
+ * Appends the first len characters of urlName with all the information,
+ * for names that aren't nul-terminated
+ */
+void ListAppendUrl(List l, const char *urlName, int len, int outDegree, 
+				   double weightPR);
+
 /**
  * Returns the number of elements in an List.
  */
@@ -59,11 +82,23 @@ char *getUrlName(List l, int order);
  */
 int getUrlNum(List l, char urlName[MAX_URL_LENGTH]);
 
+/*
+ * Returns the order of the url named by the first len characters of 
+ * urlName, or ListLength if it isn't in the list
+ */
+int ListLookup(List l, const char *urlName, int len);
+
 /*
  * Show each url and its position in the list
  */
 void listShow(List l);
 
+/*
+ * Write the list, which is in rank order, as a binary rank table.
+ * Returns false if the file can't be written
+ */
+bool ListWriteRankTable(List l, const char *path);
+
 /**
  * Sort the given list.
  * The list is in descending order by Weighted PageRank. 
@@ -79,12 +114,32 @@ List sortList(List l);
 void updateWeightedPR(char url[MAX_URL_LENGTH], List l,
                               double weightedPR);
 
+/*
+ * Copy every url's weighted page rank from the given array in one go,
+ * ranks[i] belonging to the url at position i
+ */
+void ListSetWeightedPR(List l, const double *ranks);
+
 /*
  * Go the that node with the given url, then update its outdegree
  */
 void updateAllOutDegree(Graph directUrl, List l);
 
 
+/*
+ * Work out the alphabetical order of the urls once, to be shared by
+ * every later sort of this list (appending to the list forgets it).
+ * Sorts call it themselves, but it has to be called up front before 
+ * several threads sort the same list at once.
+ */
+void ListPrepareSort(List l);
+
+/*
+ * The alphabetical rank of every url, by position in the list, as used
+ * by its sorts. Valid until the list is appended to or freed.
+ */
+const int *ListLexRanks(List l);
+
 /*
  * Sorting (descending) for searchPageRank. It depends on the 
  * number of matching search terms, weighted pag rank, and 
@@ -93,7 +148,19 @@ void updateAllOutDegree(Graph directUrl, List l);
 List searchPRSort(List pageRankL, Graph invertedIndex);
 
 /*
- * Show top 30 pages
+ * Same order as searchPRSort, but only the best k pages are kept.
+ * Uses a bounded heap instead of sorting every matching page
+ */
+List searchPRTopK(List pageRankL, Graph invertedIndex, int k);
+
+/*
+ * Same as searchPRTopK, with the number of matching terms of the page
+ * at each position already counted in matches
+ */
+List searchPRTopKMatches(List pageRankL, const int *matches, int k);
+
+/*
+ * Show top SEARCH_RESULTS pages
  */
 void searchPRShow(List sorted);
 
@@ -0,0 +1,263 @@
+// RankKernel.c - Implementation of the weighted page rank sweep kernels
+//
+// The vector kernels give every lane its own url: a block of 4 (AVX2) or
+// 8 (AVX-512) consecutive urls walks its in-links together, one link of
+// each url per step, gathering the sources' previous ranks and the link
+// weights. Lanes whose url has run out of links are masked off and add
+// 0. So each url's sum is built in the same order, and with the same
+// multiplies and adds, as in the scalar loop, and the ranks match it to
+// the bit. The change of every url is taken in the same pass and added
+// to the diff in url order, for the same reason.
+
+// Written by: Bianca Ren
+// Date: 14th Nov 2022
+
+#include <math.h>
+#include <string.h>
+
+#include "RankKernel.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define X86_KERNELS
+#include <immintrin.h>
+
+// AVX-512 has fused multiply-adds, which the compiler is free to turn a
+// multiply and an add into. The explicitly rounded forms are never fused
+#define ROUNDING (_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)
+#define MUL512(x, y) _mm512_mul_round_pd(x, y, ROUNDING)
+#define ADD512(x, y) _mm512_add_round_pd(x, y, ROUNDING)
+#endif
+
+/*
+ * The scalar loop over the urls in [from, to), adding their changes to
+ * diff one by one
+ */
+static double sweepUrls(const RankInput *in, const double *prev,
+                        double *curr, int from, int to, double diff) {
+    for (int url = from; url < to; url++) {
+        double sum = 0.0;
+        for (int e = in->offset[url]; e < in->offset[url + 1]; e++) {
+            sum += prev[in->sources[e]] * in->weights[e];
+        }
+
+        curr[url] = in->prob + in->d * sum;
+        diff += fabs(curr[url] - prev[url]);
+    }
+
+    return diff;
+}
+
+static double sweepScalar(const RankInput *in, const double *prev,
+                          double *curr, int from, int to) {
+    return sweepUrls(in, prev, curr, from, to, 0.0);
+}
+
+#ifdef X86_KERNELS
+
+/*
+ * The urls left over after the last full block. Kept out of line so that
+ * the scalar loop isn't compiled with the vector kernels' instructions,
+ * where it could be fused too
+ */
+__attribute__((noinline))
+static double sweepTail(const RankInput *in, const double *prev,
+                        double *curr, int from, int to, double diff) {
+    return sweepUrls(in, prev, curr, from, to, diff);
+}
+
+/*
+ * Most in-links of any of the n urls from url on
+ */
+static int longestBlock(const int *offset, int url, int n) {
+    int longest = 0;
+    for (int k = 0; k < n; k++) {
+        int len = offset[url + k + 1] - offset[url + k];
+        longest = len > longest ? len : longest;
+    }
+
+    return longest;
+}
+
+__attribute__((target("avx2")))
+static double sweepAvx2(const RankInput *in, const double *prev,
+                        double *curr, int from, int to) {
+    const __m256d prob = _mm256_set1_pd(in->prob);
+    const __m256d d = _mm256_set1_pd(in->d);
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+    double diff = 0.0;
+    int url = from;
+
+    for (; url + 4 <= to; url += 4) {
+        __m128i first = _mm_loadu_si128((const __m128i *) (in->offset + url));
+        __m128i next = _mm_loadu_si128(
+            (const __m128i *) (in->offset + url + 1)
+        );
+        __m128i len = _mm_sub_epi32(next, first);
+        int longest = longestBlock(in->offset, url, 4);
+
+        __m256d sum = _mm256_setzero_pd();
+        for (int j = 0; j < longest; j++) {
+            __m128i step = _mm_set1_epi32(j);
+            __m128i live = _mm_cmpgt_epi32(len, step);
+            __m256d liveD = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(live));
+            __m128i slot = _mm_add_epi32(first, step);
+
+            __m128i src = _mm_mask_i32gather_epi32(
+                _mm_setzero_si128(), in->sources, slot, live, 4
+            );
+            __m256d p = _mm256_mask_i32gather_pd(
+                _mm256_setzero_pd(), prev, src, liveD, 8
+            );
+            __m256d w = _mm256_mask_i32gather_pd(
+                _mm256_setzero_pd(), in->weights, slot, liveD, 8
+            );
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(p, w));
+        }
+
+        __m256d rank = _mm256_add_pd(prob, _mm256_mul_pd(d, sum));
+        _mm256_storeu_pd(curr + url, rank);
+
+        double change[4];
+        __m256d delta = _mm256_sub_pd(rank, _mm256_loadu_pd(prev + url));
+        _mm256_storeu_pd(change, _mm256_andnot_pd(signBit, delta));
+        for (int k = 0; k < 4; k++) {
+            diff += change[k];
+        }
+    }
+
+    return sweepTail(in, prev, curr, url, to, diff);
+}
+
+__attribute__((target("avx512f")))
+static double sweepAvx512(const RankInput *in, const double *prev,
+                          double *curr, int from, int to) {
+    const __m512d prob = _mm512_set1_pd(in->prob);
+    const __m512d d = _mm512_set1_pd(in->d);
+    double diff = 0.0;
+    int url = from;
+
+    for (; url + 8 <= to; url += 8) {
+        __m256i first = _mm256_loadu_si256(
+            (const __m256i *) (in->offset + url)
+        );
+        __m256i next = _mm256_loadu_si256(
+            (const __m256i *) (in->offset + url + 1)
+        );
+        __m512i len = _mm512_castsi256_si512(_mm256_sub_epi32(next, first));
+        int longest = longestBlock(in->offset, url, 8);
+
+        __m512d sum = _mm512_setzero_pd();
+        for (int j = 0; j < longest; j++) {
+            // only the low 8 of the 16 int lanes hold urls
+            __mmask16 live = _mm512_mask_cmpgt_epi32_mask(
+                0xff, len, _mm512_set1_epi32(j)
+            );
+            __m256i slot = _mm256_add_epi32(first, _mm256_set1_epi32(j));
+
+            __m256i src = _mm512_castsi512_si256(_mm512_mask_i32gather_epi32(
+                _mm512_setzero_si512(), live, _mm512_castsi256_si512(slot),
+                in->sources, 4
+            ));
+            __m512d p = _mm512_mask_i32gather_pd(
+                _mm512_setzero_pd(), (__mmask8) live, src, prev, 8
+            );
+            __m512d w = _mm512_mask_i32gather_pd(
+                _mm512_setzero_pd(), (__mmask8) live, slot, in->weights, 8
+            );
+            sum = ADD512(sum, MUL512(p, w));
+        }
+
+        __m512d rank = ADD512(prob, MUL512(d, sum));
+        _mm512_storeu_pd(curr + url, rank);
+
+        double change[8];
+        __m512d delta = _mm512_sub_pd(rank, _mm512_loadu_pd(prev + url));
+        _mm512_storeu_pd(change, _mm512_abs_pd(delta));
+        for (int k = 0; k < 8; k++) {
+            diff += change[k];
+        }
+    }
+
+    return sweepTail(in, prev, curr, url, to, diff);
+}
+
+#endif
+
+double RankSweepSelected(const RankInput *in, const double *prev,
+                         double *curr, const int *urls, int n) {
+    double diff = 0.0;
+
+    for (int i = 0; i < n; i++) {
+        int url = urls[i];
+        double sum = 0.0;
+        for (int e = in->offset[url]; e < in->offset[url + 1]; e++) {
+            sum += prev[in->sources[e]] * in->weights[e];
+        }
+
+        curr[url] = in->prob + in->d * sum;
+        diff += fabs(curr[url] - prev[url]);
+    }
+
+    return diff;
+}
+
+double RankSweepInPlace(const RankInput *in, double *rank, const int *order,
+                        int n) {
+    double diff = 0.0;
+
+    for (int i = 0; i < n; i++) {
+        int url = order[i];
+        double sum = 0.0;
+        for (int e = in->offset[url]; e < in->offset[url + 1]; e++) {
+            sum += rank[in->sources[e]] * in->weights[e];
+        }
+
+        double updated = in->prob + in->d * sum;
+        diff += fabs(updated - rank[url]);
+        rank[url] = updated;
+    }
+
+    return diff;
+}
+
+int RankKernelAll(RankKernel *kernels) {
+    int n = 0;
+
+    kernels[n].name = "scalar";
+    kernels[n++].sweep = sweepScalar;
+
+#ifdef X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels[n].name = "avx2";
+        kernels[n++].sweep = sweepAvx2;
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        kernels[n].name = "avx512";
+        kernels[n++].sweep = sweepAvx512;
+    }
+#endif
+
+    return n;
+}
+
+RankKernel RankKernelBest(void) {
+    RankKernel kernels[MAX_RANK_KERNELS];
+    int n = RankKernelAll(kernels);
+
+    return kernels[n - 1];
+}
+
+bool RankKernelNamed(const char *name, RankKernel *kernel) {
+    RankKernel kernels[MAX_RANK_KERNELS];
+    int n = RankKernelAll(kernels);
+
+    for (int k = 0; k < n; k++) {
+        if (strcmp(kernels[k].name, name) == 0) {
+            *kernel = kernels[k];
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,73 @@
+// RankKernel.h - Interface to the weighted page rank sweep kernels
+
+// Written by: Bianca Ren
+// Date: 14th Nov 2022
+
+#ifndef RANKKERNEL_H
+#define RANKKERNEL_H
+
+#include <stdbool.h>
+
+// The in-links of every url with their precomputed weights: the links
+// into url v are sources[offset[v] .. offset[v + 1] - 1], and weights
+// holds the weight of each in the same slots
+typedef struct rankInput {
+    const int *offset;
+    const int *sources;
+    const double *weights;
+    double prob;        // (1 - d) / N, the random jump
+    double d;
+} RankInput;
+
+/*
+ * Compute curr[url] = prob + d * sum(prev[source] * weight) for every url
+ * in [from, to), and return the sum of |curr[url] - prev[url]| over them
+ */
+typedef double (*RankSweepFn)(const RankInput *in, const double *prev,
+                              double *curr, int from, int to);
+
+typedef struct rankKernel {
+    const char *name;
+    RankSweepFn sweep;
+} RankKernel;
+
+// the most kernels RankKernelAll can return
+#define MAX_RANK_KERNELS 3
+
+/**
+ * Updates the ranks of the n urls in place, url order[0] first, so every
+ * url reads the freshest ranks of its in-links (a Gauss-Seidel sweep).
+ * Returns the sum of |new - old| over them. Scalar only, since each url
+ * can depend on the one updated just before it.
+ */
+double RankSweepInPlace(const RankInput *in, double *rank, const int *order,
+                        int n);
+
+/**
+ * Like a kernel's sweep, for only the n urls listed in urls: computes
+ * their ranks from prev into curr and returns the sum of their changes,
+ * in list order. Other urls of curr are left alone.
+ */
+double RankSweepSelected(const RankInput *in, const double *prev,
+                         double *curr, const int *urls, int n);
+
+/**
+ * Returns the fastest kernel the cpu supports. Every kernel adds up each
+ * url's in-links in the same order as the scalar one, so they all give
+ * exactly the same ranks and diffs.
+ */
+RankKernel RankKernelBest(void);
+
+/**
+ * Stores every kernel the cpu supports in kernels, scalar first, and
+ * returns how many there are (at most MAX_RANK_KERNELS).
+ */
+int RankKernelAll(RankKernel *kernels);
+
+/**
+ * Stores the kernel called name ("scalar", "avx2" or "avx512") in kernel.
+ * Returns false if the cpu doesn't support a kernel of that name.
+ */
+bool RankKernelNamed(const char *name, RankKernel *kernel);
+
+#endif
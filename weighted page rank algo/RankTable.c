@@ -0,0 +1,221 @@
+// RankTable.c - Implementation of the binary page rank table
+//
+// The layout is one file that is mapped into memory, every array 8-byte
+// aligned and holding one element per page in rank order:
+//     header
+//     weighted page ranks, as doubles
+//     out degrees, as int32
+//     alphabetical rank of each url, as int32
+//     name offsets into the string table, as uint32
+//     string table: every url, nul-terminated, back to back
+// so loading it needs no parsing and keeps the ranks' full precision.
+
+// Written by: Bianca Ren
+// Date: 14th Nov 2022
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "RankTable.h"
+
+#define RANK_TABLE_MAGIC "WPRRNK1"
+
+struct rankTableHeader {
+    char magic[8];
+    uint32_t numPages;
+    uint32_t namesSize;
+    uint64_t weightedPROffset;
+    uint64_t outDegreeOffset;
+    uint64_t lexRankOffset;
+    uint64_t nameOffset;
+    uint64_t namesOffset;
+    uint64_t size;
+};
+
+struct rankTableRep {
+    const unsigned char *data;
+    size_t size;
+
+    const struct rankTableHeader *header;
+    const double *weightedPR;
+    const int32_t *outDegree;
+    const int32_t *lexRank;
+    const uint32_t *nameAt;
+    const char *names;
+};
+
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static uint64_t alignUp(uint64_t n) {
+    return (n + 7) & ~(uint64_t) 7;
+}
+
+bool RankTableWrite(const char *path, int n, const char **names,
+                    const int *outDegree, const double *weightedPR,
+                    const int *lexRank) {
+    struct rankTableHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RANK_TABLE_MAGIC, sizeof(RANK_TABLE_MAGIC));
+    header.numPages = n;
+    for (int i = 0; i < n; i++) {
+        header.namesSize += strlen(names[i]) + 1;
+    }
+
+    header.weightedPROffset = sizeof(header);
+    header.outDegreeOffset = header.weightedPROffset + n * sizeof(double);
+    header.lexRankOffset = alignUp(header.outDegreeOffset
+                                   + n * sizeof(int32_t));
+    header.nameOffset = alignUp(header.lexRankOffset + n * sizeof(int32_t));
+    header.namesOffset = alignUp(header.nameOffset + n * sizeof(uint32_t));
+    header.size = header.namesOffset + header.namesSize;
+
+    // the whole table is built in memory, then written in one go
+    unsigned char *data = checkAlloc(calloc(header.size, 1));
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + header.weightedPROffset, weightedPR, n * sizeof(double));
+
+    int32_t *degrees = (int32_t *) (data + header.outDegreeOffset);
+    int32_t *ranks = (int32_t *) (data + header.lexRankOffset);
+    uint32_t *nameAt = (uint32_t *) (data + header.nameOffset);
+    char *nameOut = (char *) (data + header.namesOffset);
+    uint32_t at = 0;
+    for (int i = 0; i < n; i++) {
+        size_t len = strlen(names[i]) + 1;
+        degrees[i] = outDegree[i];
+        ranks[i] = lexRank[i];
+        nameAt[i] = at;
+        memcpy(nameOut + at, names[i], len);
+        at += len;
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        free(data);
+        return false;
+    }
+
+    bool ok = fwrite(data, 1, header.size, fp) == header.size;
+    free(data);
+
+    return fclose(fp) == 0 && ok;
+}
+
+/*
+ * Check that the array of n elements of the given size at offset lies
+ * inside the file, without adding anything that could wrap around
+ */
+static bool fits(uint64_t offset, uint64_t n, size_t elementSize, 
+                 size_t size) {
+    return offset <= size && n <= (size - offset) / elementSize;
+}
+
+/*
+ * Check that every array and name lies inside the file
+ */
+static bool validTable(const unsigned char *data, size_t size) {
+    const struct rankTableHeader *h = (const void *) data;
+    uint64_t n = h->numPages;
+    if (
+        memcmp(h->magic, RANK_TABLE_MAGIC, sizeof(RANK_TABLE_MAGIC)) != 0 ||
+        h->size != size ||
+        h->weightedPROffset % 8 != 0 || h->outDegreeOffset % 8 != 0 ||
+        h->lexRankOffset % 8 != 0 || h->nameOffset % 8 != 0 ||
+        !fits(h->weightedPROffset, n, sizeof(double), size) ||
+        !fits(h->outDegreeOffset, n, sizeof(int32_t), size) ||
+        !fits(h->lexRankOffset, n, sizeof(int32_t), size) ||
+        !fits(h->nameOffset, n, sizeof(uint32_t), size) ||
+        !fits(h->namesOffset, h->namesSize, 1, size) ||
+        (h->namesSize > 0 && data[h->namesOffset + h->namesSize - 1] != '\0')
+    ) {
+        return false;
+    }
+
+    const int32_t *lexRank = (const void *) (data + h->lexRankOffset);
+    const uint32_t *nameAt = (const void *) (data + h->nameOffset);
+    for (uint64_t i = 0; i < n; i++) {
+        if (
+            nameAt[i] >= h->namesSize ||
+            lexRank[i] < 0 || (uint64_t) lexRank[i] >= n
+        ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+RankTable RankTableOpen(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (
+        fstat(fd, &st) == -1 ||
+        st.st_size < (off_t) sizeof(struct rankTableHeader)
+    ) {
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (!validTable(data, st.st_size)) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    RankTable t = checkAlloc(malloc(sizeof(*t)));
+    t->data = data;
+    t->size = st.st_size;
+    t->header = data;
+    t->weightedPR = (const void *) (t->data + t->header->weightedPROffset);
+    t->outDegree = (const void *) (t->data + t->header->outDegreeOffset);
+    t->lexRank = (const void *) (t->data + t->header->lexRankOffset);
+    t->nameAt = (const void *) (t->data + t->header->nameOffset);
+    t->names = (const char *) t->data + t->header->namesOffset;
+
+    return t;
+}
+
+void RankTableFree(RankTable t) {
+    munmap((void *) t->data, t->size);
+    free(t);
+}
+
+int RankTableSize(RankTable t) {
+    return t->header->numPages;
+}
+
+const char *RankTableName(RankTable t, int rank) {
+    return t->names + t->nameAt[rank];
+}
+
+const int32_t *RankTableOutDegrees(RankTable t) {
+    return t->outDegree;
+}
+
+const double *RankTableWeightedPRs(RankTable t) {
+    return t->weightedPR;
+}
+
+const int32_t *RankTableLexRanks(RankTable t) {
+    return t->lexRank;
+}
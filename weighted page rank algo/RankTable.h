@@ -0,0 +1,54 @@
+// RankTable.h - Interface to the binary page rank table
+
+// Written by: Bianca Ren
+// Date: 14th Nov 2022
+
+#ifndef RANKTABLE_H
+#define RANKTABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// file searchPageRank reads instead of pageRankList.txt when it is newer
+#define RANK_TABLE_FILE "./pageRankList.bin"
+
+typedef struct rankTableRep *RankTable;
+
+/**
+ * Writes n pages, already in rank order, to the given file: their names,
+ * out degrees, full-precision weighted page ranks and the alphabetical
+ * rank of every name. Returns false on failure.
+ */
+bool RankTableWrite(const char *path, int n, const char **names,
+                    const int *outDegree, const double *weightedPR,
+                    const int *lexRank);
+
+/**
+ * Maps a rank table file into memory. Returns NULL if the file can't be
+ * opened or isn't a valid rank table.
+ */
+RankTable RankTableOpen(const char *path);
+
+/**
+ * Unmaps the table. Pointers into it are no longer valid.
+ */
+void RankTableFree(RankTable t);
+
+/**
+ * Returns the number of pages in the table.
+ */
+int RankTableSize(RankTable t);
+
+/**
+ * Returns the url of the page at the given rank.
+ */
+const char *RankTableName(RankTable t, int rank);
+
+/**
+ * The arrays below have one element per page, in rank order.
+ */
+const int32_t *RankTableOutDegrees(RankTable t);
+const double *RankTableWeightedPRs(RankTable t);
+const int32_t *RankTableLexRanks(RankTable t);
+
+#endif
@@ -0,0 +1,214 @@
+// Reader.c - Implementation of the whitespace token reader
+//
+// The whole input is kept in memory, mapped when it is a regular file
+// and read to the end up front otherwise, and tokens are handed out as 
+// spans into it, so nothing is copied and no token is too long.
+
+// Written by: Bianca Ren
+// Date: 14th Nov 2022
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Reader.h"
+
+// starting buffer size when the input can't be mapped
+#define READ_CHUNK (1 << 16)
+// longest number ReaderDouble copies onto the stack
+#define MAX_NUMBER_LENGTH 64
+
+// where the input of a reader lives, which decides how it is released
+enum readerInput { READ_HEAP, READ_MAPPED, READ_BORROWED };
+
+struct readerRep {
+    const char *data;
+    size_t size;
+    size_t at;
+    enum readerInput input;
+};
+
+// the characters isspace() accepts in the C locale
+static const bool isBlank[256] = {
+    [' '] = true, ['\t'] = true, ['\n'] = true, 
+    ['\v'] = true, ['\f'] = true, ['\r'] = true,
+};
+
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static Reader newReader(const char *data, size_t size, 
+                        enum readerInput input) {
+    Reader r = checkAlloc(malloc(sizeof(*r)));
+    r->data = data;
+    r->size = size;
+    r->at = 0;
+    r->input = input;
+    return r;
+}
+
+Reader ReaderFromFd(int fd) {
+    size_t cap = READ_CHUNK;
+    size_t len = 0;
+    char *buf = checkAlloc(malloc(cap));
+
+    while (true) {
+        if (len == cap) {
+            cap *= 2;
+            buf = checkAlloc(realloc(buf, cap));
+        }
+
+        ssize_t n = read(fd, buf + len, cap - len);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            break;
+        }
+        len += n;
+    }
+
+    return newReader(buf, len, READ_HEAP);
+}
+
+Reader ReaderOpen(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            close(fd);
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            return newReader(data, st.st_size, READ_MAPPED);
+        }
+    }
+
+    Reader r = ReaderFromFd(fd);
+    close(fd);
+    return r;
+}
+
+Reader ReaderFromMemory(const char *data, size_t size) {
+    return newReader(data, size, READ_BORROWED);
+}
+
+void ReaderClose(Reader r) {
+    if (r->input == READ_MAPPED) {
+        munmap((void *) r->data, r->size);
+    } else if (r->input == READ_HEAP) {
+        free((void *) r->data);
+    }
+
+    free(r);
+}
+
+bool ReaderToken(Reader r, Span *token) {
+    const unsigned char *data = (const unsigned char *) r->data;
+    size_t at = r->at;
+
+    while (at < r->size && isBlank[data[at]]) {
+        at++;
+    }
+
+    if (at == r->size) {
+        r->at = at;
+        return false;
+    }
+
+    size_t from = at;
+    while (at < r->size && !isBlank[data[at]]) {
+        at++;
+    }
+
+    token->start = r->data + from;
+    token->len = at - from;
+    r->at = at;
+    return true;
+}
+
+bool ReaderInt(Reader r, int *value) {
+    Span token;
+    if (!ReaderToken(r, &token)) {
+        return false;
+    }
+
+    const char *s = token.start;
+    const char *stop = s + token.len;
+    bool negative = *s == '-';
+    if (*s == '-' || *s == '+') {
+        s++;
+    }
+
+    if (s == stop) {
+        return false;
+    }
+
+    long long n = 0;
+    for (; s < stop; s++) {
+        if (*s < '0' || *s > '9') {
+            return false;
+        }
+        if (n <= (long long) INT_MAX + 1) {
+            n = n * 10 + (*s - '0');
+        }
+    }
+
+    *value = (int) (negative ? -n : n);
+    return true;
+}
+
+bool ReaderDouble(Reader r, double *value) {
+    Span token;
+    if (!ReaderToken(r, &token) || token.len >= MAX_NUMBER_LENGTH) {
+        return false;
+    }
+
+    // strtod needs a nul-terminated copy
+    char number[MAX_NUMBER_LENGTH];
+    memcpy(number, token.start, token.len);
+    number[token.len] = '\0';
+
+    char *stop;
+    double d = strtod(number, &stop);
+    if (stop != number + token.len) {
+        return false;
+    }
+
+    *value = d;
+    return true;
+}
+
+bool ReaderLine(Reader r, Span *line) {
+    if (r->at == r->size) {
+        return false;
+    }
+
+    const char *from = r->data + r->at;
+    const char *newline = memchr(from, '\n', r->size - r->at);
+    size_t len = newline == NULL ? r->size - r->at 
+                                 : (size_t) (newline - from) + 1;
+
+    line->start = from;
+    line->len = len;
+    r->at += len;
+    return true;
+}
+
+bool SpanEquals(Span s, const char *str) {
+    return strlen(str) == s.len && memcmp(s.start, str, s.len) == 0;
+}
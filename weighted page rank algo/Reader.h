@@ -0,0 +1,78 @@
+// Reader.h - Interface to the whitespace token reader
+
+// Written by: Bianca Ren
+// Date: 14th Nov 2022
+
+#ifndef READER_H
+#define READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct readerRep *Reader;
+
+/**
+ * A piece of the input: `len` characters starting at `start`. It is not
+ * nul-terminated, and it is only valid until the reader is closed.
+ */
+typedef struct {
+    const char *start;
+    size_t len;
+} Span;
+
+/**
+ * Opens a file for reading. Regular files are mapped into memory, 
+ * anything else is read to the end, as ReaderFromFd does. Returns NULL 
+ * if the file can't be opened.
+ */
+Reader ReaderOpen(const char *path);
+
+/**
+ * Reads everything from an open file descriptor, such as standard
+ * input, into memory before returning, so that spans stay valid until 
+ * the reader is closed. Nothing can be read from the reader until the
+ * input ends. The descriptor is not closed by ReaderClose.
+ */
+Reader ReaderFromFd(int fd);
+
+/**
+ * Reads from size bytes of memory that the caller keeps alive until the
+ * reader is closed, such as a page inside a mapped archive.
+ */
+Reader ReaderFromMemory(const char *data, size_t size);
+
+/**
+ * Closes the reader. Spans it returned are no longer valid.
+ */
+void ReaderClose(Reader r);
+
+/**
+ * Reads the next whitespace separated token, like fscanf's "%s" but of
+ * any length. Returns false at the end of the input.
+ */
+bool ReaderToken(Reader r, Span *token);
+
+/**
+ * Reads the next token as an int, like fscanf's "%d". Returns false at 
+ * the end of the input or if the token isn't a number.
+ */
+bool ReaderInt(Reader r, int *value);
+
+/**
+ * Reads the next token as a double, like fscanf's "%lf". Returns false 
+ * at the end of the input or if the token isn't a number.
+ */
+bool ReaderDouble(Reader r, double *value);
+
+/**
+ * Reads the rest of the current line, including its newline if it has 
+ * one. Returns false at the end of the input.
+ */
+bool ReaderLine(Reader r, Span *line);
+
+/**
+ * Returns true if the span holds exactly the given string.
+ */
+bool SpanEquals(Span s, const char *str);
+
+#endif
@@ -0,0 +1,518 @@
+// Server.c - Implementation of the line-based query server
+// Every query is timed, and the STATS_QUERY line reports the number of
+// queries, the p50/p99/mean latency and the throughput so far. Latencies
+// go into a fixed log-scale histogram, so a long-running server uses the
+// same memory however many queries it has answered, and the percentiles
+// are accurate to the width of a bucket (about 9%).
+
+// Written by: Bianca Ren
+// Date: 13rd Nov 2022
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Server.h"
+#include "ThreadPool.h"
+
+#define READ_SIZE 65536
+
+// latency histogram: bucket 0 holds everything under LATENCY_MIN, and
+// every later bucket is 2^(1 / BUCKETS_PER_DOUBLING) times as wide as
+// the one before, up to about 100 seconds in the last
+#define LATENCY_MIN 1e-7
+#define BUCKETS_PER_DOUBLING 8
+#define LATENCY_BUCKETS (30 * BUCKETS_PER_DOUBLING + 1)
+
+struct stats {
+    pthread_mutex_t lock;
+    long count[LATENCY_BUCKETS];
+    long size;
+    double total;           // seconds, over all queries
+    double max;
+    double started;
+};
+
+struct server {
+    QueryFn fn;
+    void *ctx;
+    struct stats stats;
+    int listenFd;
+};
+
+// one batch of query lines for the stream mode
+struct batch {
+    struct server *server;
+    char **lines;
+    OutBuf *out;
+    int size;
+    int numWorkers;
+};
+
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void OutBufAppend(OutBuf *b, const char *s, size_t n) {
+    if (b->len + n > b->cap) {
+        while (b->len + n > b->cap) {
+            b->cap = b->cap == 0 ? 4096 : b->cap * 2;
+        }
+        b->data = checkAlloc(realloc(b->data, b->cap));
+    }
+
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+}
+
+void OutBufPrintf(OutBuf *b, const char *fmt, ...) {
+    char line[256];
+    va_list args;
+
+    va_start(args, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    if (n < 0) {
+        return;
+    }
+    OutBufAppend(b, line, (size_t) n < sizeof(line) ? (size_t) n 
+                                                    : sizeof(line) - 1);
+}
+
+void OutBufFree(OutBuf *b) {
+    free(b->data);
+    b->data = NULL;
+    b->len = 0;
+    b->cap = 0;
+}
+
+/*
+ * Write the whole buffer, then empty it. Returns false if the other end
+ * went away
+ */
+static bool flushOut(int fd, OutBuf *b) {
+    size_t done = 0;
+    while (done < b->len) {
+        ssize_t n = write(fd, b->data + done, b->len - done);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+
+    b->len = 0;
+    return true;
+}
+
+static void initServer(struct server *s, QueryFn fn, void *ctx) {
+    s->fn = fn;
+    s->ctx = ctx;
+    s->listenFd = -1;
+    pthread_mutex_init(&s->stats.lock, NULL);
+    memset(s->stats.count, 0, sizeof(s->stats.count));
+    s->stats.size = 0;
+    s->stats.total = 0.0;
+    s->stats.max = 0.0;
+    s->stats.started = now();
+}
+
+static void freeServer(struct server *s) {
+    pthread_mutex_destroy(&s->stats.lock);
+}
+
+static int latencyBucket(double seconds) {
+    if (seconds < LATENCY_MIN) {
+        return 0;
+    }
+
+    int b = 1 + (int) (log2(seconds / LATENCY_MIN) * BUCKETS_PER_DOUBLING);
+    return b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+}
+
+/*
+ * The largest latency that falls into the bucket
+ */
+static double bucketTop(int b) {
+    return LATENCY_MIN * exp2((double) b / BUCKETS_PER_DOUBLING);
+}
+
+static void recordLatency(struct stats *st, double seconds) {
+    int b = latencyBucket(seconds);
+
+    pthread_mutex_lock(&st->lock);
+    st->count[b]++;
+    st->size++;
+    st->total += seconds;
+    if (seconds > st->max) {
+        st->max = seconds;
+    }
+    pthread_mutex_unlock(&st->lock);
+}
+
+/*
+ * Nearest-rank percentile, as the top of the bucket it falls in but no
+ * more than the slowest query
+ */
+static double percentile(const long *count, long n, double max, double p) {
+    long rank = (long) (p / 100.0 * n + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    long seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        seen += count[b];
+        if (seen >= rank) {
+            return bucketTop(b) < max ? bucketTop(b) : max;
+        }
+    }
+
+    return max;
+}
+
+static void showStats(struct stats *st, OutBuf *out) {
+    long count[LATENCY_BUCKETS];
+
+    pthread_mutex_lock(&st->lock);
+    memcpy(count, st->count, sizeof(count));
+    long n = st->size;
+    double total = st->total;
+    double max = st->max;
+    pthread_mutex_unlock(&st->lock);
+
+    double elapsed = now() - st->started;
+
+    OutBufPrintf(out, "queries %ld\n", n);
+    if (n > 0) {
+        OutBufPrintf(out, "p50 %.1lf us\n", 
+                     percentile(count, n, max, 50) * 1e6);
+        OutBufPrintf(out, "p99 %.1lf us\n", 
+                     percentile(count, n, max, 99) * 1e6);
+        OutBufPrintf(out, "mean %.1lf us\n", total / n * 1e6);
+    }
+    OutBufPrintf(out, "throughput %.1lf queries/s\n", 
+                 elapsed > 0 ? n / elapsed : 0.0);
+}
+
+static bool blankLine(const char *line) {
+    while (isspace((unsigned char) *line)) {
+        line++;
+    }
+
+    return *line == '\0';
+}
+
+/*
+ * Answer one line: either the statistics or a timed query. A blank line
+ * gets an empty response and isn't counted. Every response ends with an
+ * empty line
+ */
+static void answer(struct server *s, int worker, char *line, OutBuf *out) {
+    if (strcmp(line, STATS_QUERY) == 0) {
+        showStats(&s->stats, out);
+    } else if (!blankLine(line)) {
+        double start = now();
+        s->fn(s->ctx, worker, line, out);
+        recordLatency(&s->stats, now() - start);
+    }
+
+    OutBufAppend(out, "\n", 1);
+}
+
+/*
+ * Split the complete lines at the front of buf into lines[], ending each
+ * with a nul. Returns the number of lines and sets *used to the bytes
+ * they took up
+ */
+static int splitLines(char *buf, size_t len, char ***lines, int *cap, 
+                      size_t *used) {
+    int n = 0;
+    size_t start = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] != '\n') {
+            continue;
+        }
+
+        if (n == *cap) {
+            *cap = *cap == 0 ? 64 : *cap * 2;
+            *lines = checkAlloc(realloc(*lines, *cap * sizeof(char *)));
+        }
+
+        buf[i] = '\0';
+        if (i > start && buf[i - 1] == '\r') {
+            buf[i - 1] = '\0';
+        }
+        (*lines)[n++] = buf + start;
+        start = i + 1;
+    }
+
+    *used = start;
+    return n;
+}
+
+static void answerBatch(void *arg, int worker) {
+    struct batch *b = arg;
+
+    for (int i = worker; i < b->size; i += b->numWorkers) {
+        b->out[i].len = 0;
+        answer(b->server, worker, b->lines[i], &b->out[i]);
+    }
+}
+
+bool ServeStream(int inFd, int outFd, int numWorkers, QueryFn fn, void *ctx) {
+    struct server s;
+    initServer(&s, fn, ctx);
+
+    ThreadPool pool = PoolNew(numWorkers);
+    size_t cap = READ_SIZE;
+    size_t len = 0;
+    char *buf = checkAlloc(malloc(cap + 1));
+    char **lines = NULL;
+    int linesCap = 0;
+    OutBuf *out = NULL;
+    int outCap = 0;
+    bool eof = false;
+    bool written = true;
+
+    while (!eof && written) {
+        if (len == cap) {
+            cap *= 2;
+            buf = checkAlloc(realloc(buf, cap + 1));
+        }
+
+        ssize_t n = read(inFd, buf + len, cap - len);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            // answer a last line without a newline too
+            eof = true;
+            if (len > 0) {
+                buf[len++] = '\n';
+            }
+        } else {
+            len += n;
+        }
+
+        // everything read so far is one batch
+        size_t used;
+        int numLines = splitLines(buf, len, &lines, &linesCap, &used);
+        if (numLines > outCap) {
+            out = checkAlloc(realloc(out, numLines * sizeof(OutBuf)));
+            memset(out + outCap, 0, (numLines - outCap) * sizeof(OutBuf));
+            outCap = numLines;
+        }
+
+        // queries run in parallel, but a statistics line waits for the
+        // queries before it
+        int from = 0;
+        while (from < numLines) {
+            if (strcmp(lines[from], STATS_QUERY) == 0) {
+                out[from].len = 0;
+                answer(&s, 0, lines[from], &out[from]);
+                from++;
+                continue;
+            }
+
+            int to = from;
+            while (to < numLines && strcmp(lines[to], STATS_QUERY) != 0) {
+                to++;
+            }
+
+            struct batch b = { 
+                &s, lines + from, out + from, to - from, numWorkers 
+            };
+            PoolRun(pool, answerBatch, &b);
+            from = to;
+        }
+
+        for (int i = 0; i < numLines && written; i++) {
+            written = flushOut(outFd, &out[i]);
+        }
+
+        memmove(buf, buf + used, len - used);
+        len -= used;
+    }
+
+    for (int i = 0; i < outCap; i++) {
+        OutBufFree(&out[i]);
+    }
+    free(out);
+    free(lines);
+    free(buf);
+    PoolFree(pool);
+    freeServer(&s);
+
+    if (!written) {
+        perror("write");
+    }
+    return written;
+}
+
+/*
+ * Answer queries on one connection until the client hangs up
+ */
+static void serveConnection(struct server *s, int worker, int fd) {
+    size_t cap = READ_SIZE;
+    size_t len = 0;
+    char *buf = checkAlloc(malloc(cap));
+    char **lines = NULL;
+    int linesCap = 0;
+    OutBuf out = { NULL, 0, 0 };
+
+    while (true) {
+        if (len == cap) {
+            cap *= 2;
+            buf = checkAlloc(realloc(buf, cap));
+        }
+
+        ssize_t n = read(fd, buf + len, cap - len);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            break;
+        }
+        len += n;
+
+        size_t used;
+        int numLines = splitLines(buf, len, &lines, &linesCap, &used);
+        for (int i = 0; i < numLines; i++) {
+            answer(s, worker, lines[i], &out);
+        }
+
+        if (!flushOut(fd, &out)) {
+            break;
+        }
+
+        memmove(buf, buf + used, len - used);
+        len -= used;
+    }
+
+    OutBufFree(&out);
+    free(lines);
+    free(buf);
+}
+
+static void acceptLoop(void *arg, int worker) {
+    struct server *s = arg;
+
+    while (true) {
+        int fd = accept(s->listenFd, NULL, NULL);
+        if (fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("accept");
+            return;
+        }
+
+        serveConnection(s, worker, fd);
+        close(fd);
+    }
+}
+
+/*
+ * Nothing answers at addr: connecting is refused and what is there is a
+ * socket. A regular file refuses connections too, so it is looked at
+ * after the connection rather than before
+ */
+static bool staleSocket(const struct sockaddr_un *addr) {
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe == -1) {
+        return false;
+    }
+
+    bool refused = 
+        connect(probe, (const struct sockaddr *) addr, sizeof(*addr)) == -1 
+        && errno == ECONNREFUSED;
+    close(probe);
+
+    struct stat st;
+    return refused && lstat(addr->sun_path, &st) == 0 && 
+           S_ISSOCK(st.st_mode);
+}
+
+/*
+ * Bind first, so a path that is free is never looked at. A path in use
+ * is only taken over, once, from a socket that no server listens on; a
+ * running server or a file that happens to be there is left alone
+ */
+static bool bindSocket(int fd, const struct sockaddr_un *addr) {
+    const struct sockaddr *a = (const struct sockaddr *) addr;
+    if (bind(fd, a, sizeof(*addr)) == 0) {
+        return true;
+    } else if (errno != EADDRINUSE) {
+        return false;
+    } else if (!staleSocket(addr)) {
+        // what the probe ran into says less than why bind failed
+        errno = EADDRINUSE;
+        return false;
+    }
+
+    unlink(addr->sun_path);
+    return bind(fd, a, sizeof(*addr)) == 0;
+}
+
+void ServeSocket(const char *path, int numWorkers, QueryFn fn, void *ctx) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return;
+    }
+    strcpy(addr.sun_path, path);
+
+    // a client hanging up mid-response must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        perror("socket");
+        return;
+    }
+
+    if (!bindSocket(fd, &addr) || listen(fd, 64) == -1) {
+        perror(path);
+        close(fd);
+        return;
+    }
+
+    struct server s;
+    initServer(&s, fn, ctx);
+    s.listenFd = fd;
+
+    ThreadPool pool = PoolNew(numWorkers);
+    PoolRun(pool, acceptLoop, &s);
+    PoolFree(pool);
+
+    freeServer(&s);
+    close(fd);
+    unlink(path);
+}
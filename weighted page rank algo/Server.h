@@ -0,0 +1,52 @@
+// Server.h - Interface to the line-based query server
+
+// Written by: Bianca Ren
+// Date: 13rd Nov 2022
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// query line that asks for the latency and throughput statistics
+#define STATS_QUERY "#stats"
+
+// A growable output buffer. Responses are built in one and written out
+// with a single write instead of one printf per line
+typedef struct outBuf {
+    char *data;
+    size_t len;
+    size_t cap;
+} OutBuf;
+
+void OutBufAppend(OutBuf *b, const char *s, size_t n);
+void OutBufPrintf(OutBuf *b, const char *fmt, ...);
+void OutBufFree(OutBuf *b);
+
+/**
+ * Answers one query line (without its newline), appending the response
+ * to out. `worker` says which worker runs it, from 0 to numWorkers - 1,
+ * so the handler can keep scratch space per worker.
+ */
+typedef void (*QueryFn)(void *ctx, int worker, char *query, OutBuf *out);
+
+/**
+ * Answers newline-delimited queries read from inFd until end of file,
+ * writing the responses to outFd in the order of the queries. Every 
+ * response ends with an empty line, and blank lines get just that. 
+ * Queries that arrive together are shared out between numWorkers 
+ * workers. Stops early and returns false if a response can't be written.
+ */
+bool ServeStream(int inFd, int outFd, int numWorkers, QueryFn fn, void *ctx);
+
+/**
+ * Listens on a Unix domain socket at the given path and answers queries
+ * the same way as ServeStream, one connection per worker at a time.
+ * A socket at the path that no server listens on is replaced, but a 
+ * listening one or any other file is left alone and the server doesn't
+ * start. Only returns if the socket can't be set up.
+ */
+void ServeSocket(const char *path, int numWorkers, QueryFn fn, void *ctx);
+
+#endif
@@ -0,0 +1,177 @@
+// Sort.c - Implementation of the ranking sort engine
+
+// Written by: Bianca Ren
+// Date: 13rd Nov 2022
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Sort.h"
+
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+/*
+ * Return true if page a ranks before page b
+ */
+static bool before(const RankKey *a, const RankKey *b) {
+    if (a->matches != b->matches) {
+        return a->matches > b->matches;
+    } else if (a->weightedPR != b->weightedPR) {
+        return a->weightedPR > b->weightedPR;
+    } else if (a->lexRank != b->lexRank) {
+        return a->lexRank < b->lexRank;
+    }
+
+    return a->page < b->page;
+}
+
+static void mergeKeys(RankKey *keys, RankKey *tmp, int lo, int hi) {
+    if (hi - lo < 2) {
+        return;
+    }
+
+    int mid = lo + (hi - lo) / 2;
+    mergeKeys(keys, tmp, lo, mid);
+    mergeKeys(keys, tmp, mid, hi);
+
+    // already in order
+    if (!before(&keys[mid], &keys[mid - 1])) {
+        return;
+    }
+
+    int i = lo, j = mid, k = lo;
+    while (i < mid && j < hi) {
+        tmp[k++] = before(&keys[j], &keys[i]) ? keys[j++] : keys[i++];
+    }
+    while (i < mid) {
+        tmp[k++] = keys[i++];
+    }
+    while (j < hi) {
+        tmp[k++] = keys[j++];
+    }
+
+    memcpy(keys + lo, tmp + lo, (hi - lo) * sizeof(RankKey));
+}
+
+void SortByRank(RankKey *keys, int n) {
+    RankKey *tmp = checkAlloc(malloc((n > 0 ? n : 1) * sizeof(RankKey)));
+    mergeKeys(keys, tmp, 0, n);
+    free(tmp);
+}
+
+static void mergeNames(const char **names, int *idx, int *tmp, 
+                       int lo, int hi) {
+    if (hi - lo < 2) {
+        return;
+    }
+
+    int mid = lo + (hi - lo) / 2;
+    mergeNames(names, idx, tmp, lo, mid);
+    mergeNames(names, idx, tmp, mid, hi);
+
+    int i = lo, j = mid, k = lo;
+    while (i < mid && j < hi) {
+        if (strcmp(names[idx[j]], names[idx[i]]) < 0) {
+            tmp[k++] = idx[j++];
+        } else {
+            tmp[k++] = idx[i++];
+        }
+    }
+    while (i < mid) {
+        tmp[k++] = idx[i++];
+    }
+    while (j < hi) {
+        tmp[k++] = idx[j++];
+    }
+
+    memcpy(idx + lo, tmp + lo, (hi - lo) * sizeof(int));
+}
+
+int *SortLexicalRanks(const char **names, int n) {
+    int size = n > 0 ? n : 1;
+    int *idx = checkAlloc(malloc(size * sizeof(int)));
+    int *tmp = checkAlloc(malloc(size * sizeof(int)));
+
+    for (int i = 0; i < n; i++) {
+        idx[i] = i;
+    }
+
+    mergeNames(names, idx, tmp, 0, n);
+
+    // tmp becomes the inverse permutation
+    for (int i = 0; i < n; i++) {
+        tmp[idx[i]] = i;
+    }
+
+    free(idx);
+    return tmp;
+}
+
+/*
+ * Move the key at i down the min-heap (worst page at the root)
+ */
+static void siftDown(RankKey *heap, int size, int i) {
+    while (true) {
+        int worst = i;
+        int l = 2 * i + 1;
+        int r = 2 * i + 2;
+
+        if (l < size && before(&heap[worst], &heap[l])) {
+            worst = l;
+        }
+        if (r < size && before(&heap[worst], &heap[r])) {
+            worst = r;
+        }
+        if (worst == i) {
+            return;
+        }
+
+        RankKey temp = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = temp;
+        i = worst;
+    }
+}
+
+int SortTopK(const RankKey *keys, int n, int k, RankKey *best) {
+    int size = 0;
+    if (k <= 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (size < k) {
+            // sift up
+            int j = size++;
+            best[j] = keys[i];
+            while (j > 0 && before(&best[(j - 1) / 2], &best[j])) {
+                RankKey temp = best[j];
+                best[j] = best[(j - 1) / 2];
+                best[(j - 1) / 2] = temp;
+                j = (j - 1) / 2;
+            }
+        } else if (before(&keys[i], &best[0])) {
+            best[0] = keys[i];
+            siftDown(best, size, 0);
+        }
+    }
+
+    // pop the worst page into the back until the heap is empty
+    for (int end = size - 1; end > 0; end--) {
+        RankKey temp = best[0];
+        best[0] = best[end];
+        best[end] = temp;
+        siftDown(best, end, 0);
+    }
+
+    return size;
+}
@@ -0,0 +1,38 @@
+// Sort.h - Interface to the ranking sort engine
+
+// Written by: Bianca Ren
+// Date: 13rd Nov 2022
+
+#ifndef SORT_H
+#define SORT_H
+
+// Everything needed to order one page, so comparing two pages never has
+// to look at the url names or the inverted index again
+typedef struct rankKey {
+    int matches;        // matching search terms, 0 when not searching
+    int lexRank;        // position of the url in alphabetical order
+    double weightedPR;
+    int page;           // position of the page in its list
+} RankKey;
+
+/**
+ * Returns the alphabetical rank of every name: ranks[i] is the number of
+ * names that sort before names[i] (equal names are ranked by index).
+ * The caller frees the array.
+ */
+int *SortLexicalRanks(const char **names, int n);
+
+/**
+ * Sorts the keys, best page first: more matches, then higher weighted
+ * page rank, then alphabetical order by url. O(n log n) merge sort.
+ */
+void SortByRank(RankKey *keys, int n);
+
+/**
+ * Stores the best k keys in `best`, best page first, without sorting the
+ * rest. Keeps a bounded min-heap of size k, so it is O(n log k).
+ * Returns how many keys were stored (at most k).
+ */
+int SortTopK(const RankKey *keys, int n, int k, RankKey *best);
+
+#endif
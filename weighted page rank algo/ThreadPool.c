@@ -0,0 +1,128 @@
+// ThreadPool.c - Implementation of a fixed pool of worker threads
+// Workers sleep on a barrier between runs, so a pool can be reused
+// every iteration without creating threads again.
+
+// Written by: Bianca Ren
+// Date: 7th Nov 2022
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ThreadPool.h"
+
+struct worker {
+    ThreadPool pool;
+    int id;
+};
+
+struct threadPool {
+    int numWorkers;
+    pthread_t *threads;
+    struct worker *workers;
+    pthread_barrier_t start;
+    pthread_barrier_t done;
+
+    // the current run, only written while every worker waits on `start`
+    PoolTask task;
+    void *arg;
+    bool quit;
+};
+
+static void *workerLoop(void *data) {
+    struct worker *w = data;
+    ThreadPool pool = w->pool;
+
+    while (true) {
+        pthread_barrier_wait(&pool->start);
+        if (pool->quit) {
+            break;
+        }
+
+        pool->task(pool->arg, w->id);
+        pthread_barrier_wait(&pool->done);
+    }
+
+    return NULL;
+}
+
+ThreadPool PoolNew(int numWorkers) {
+    assert(numWorkers > 0);
+
+    ThreadPool pool = malloc(sizeof(*pool));
+    if (pool == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pool->numWorkers = numWorkers;
+    pool->task = NULL;
+    pool->arg = NULL;
+    pool->quit = false;
+    pool->threads = NULL;
+    pool->workers = NULL;
+
+    if (numWorkers == 1) {
+        return pool;
+    }
+
+    pool->threads = malloc(numWorkers * sizeof(pthread_t));
+    pool->workers = malloc(numWorkers * sizeof(struct worker));
+    if (pool->threads == NULL || pool->workers == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_barrier_init(&pool->start, NULL, numWorkers);
+    pthread_barrier_init(&pool->done, NULL, numWorkers);
+
+    for (int i = 1; i < numWorkers; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        if (pthread_create(&pool->threads[i], NULL, workerLoop,
+                           &pool->workers[i]) != 0) {
+            fprintf(stderr, "error: can't create worker thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return pool;
+}
+
+void PoolFree(ThreadPool pool) {
+    if (pool->numWorkers > 1) {
+        pool->quit = true;
+        pthread_barrier_wait(&pool->start);
+
+        for (int i = 1; i < pool->numWorkers; i++) {
+            pthread_join(pool->threads[i], NULL);
+        }
+
+        pthread_barrier_destroy(&pool->start);
+        pthread_barrier_destroy(&pool->done);
+    }
+
+    free(pool->threads);
+    free(pool->workers);
+    free(pool);
+}
+
+int PoolSize(ThreadPool pool) {
+    return pool->numWorkers;
+}
+
+void PoolRun(ThreadPool pool, PoolTask task, void *arg) {
+    if (pool->numWorkers == 1) {
+        task(arg, 0);
+        return;
+    }
+
+    pool->task = task;
+    pool->arg = arg;
+
+    pthread_barrier_wait(&pool->start);
+    task(arg, 0);
+    pthread_barrier_wait(&pool->done);
+}
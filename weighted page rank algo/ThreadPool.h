@@ -0,0 +1,39 @@
+// ThreadPool.h - Interface to a fixed pool of worker threads
+
+// Written by: Bianca Ren
+// Date: 7th Nov 2022
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+typedef struct threadPool *ThreadPool;
+
+/**
+ * A task is run once by every worker. `worker` goes from 0 to 
+ * PoolSize(pool) - 1, so each worker can pick its own share of the work.
+ */
+typedef void (*PoolTask)(void *arg, int worker);
+
+/**
+ * Creates a pool of numWorkers workers. The calling thread acts as
+ * worker 0, so numWorkers - 1 threads are started. A pool of one worker
+ * starts no threads at all.
+ */
+ThreadPool PoolNew(int numWorkers);
+
+/**
+ * Frees the pool and joins all of its threads.
+ */
+void PoolFree(ThreadPool pool);
+
+/**
+ * Returns the number of workers in the pool.
+ */
+int PoolSize(ThreadPool pool);
+
+/**
+ * Runs the task on every worker and returns once all of them finished.
+ */
+void PoolRun(ThreadPool pool, PoolTask task, void *arg);
+
+#endif
@@ -0,0 +1,185 @@
+// UrlTable.c - Implementation of the url intern table
+// An open addressing (linear probing) hash from url to a dense id. All 
+// names are stored back to back in one string arena, and an id's name is
+// found through its offset into the arena.
+
+// Written by: Bianca Ren
+// Date: 7th Nov 2022
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "UrlTable.h"
+
+#define EMPTY_SLOT -1
+#define INITIAL_SLOTS 64
+#define INITIAL_ARENA 1024
+
+struct urlTableRep {
+    int size;           // number of urls (ids)
+    int cap;            // room in the per-id arrays
+    size_t *offset;     // where each id's name starts in the arena
+    int *length;
+    uint32_t *hash;     // kept so growing the slots needs no rehashing
+
+    char *arena;
+    size_t arenaUsed;
+    size_t arenaCap;
+
+    int *slots;         // ids, or EMPTY_SLOT
+    int numSlots;       // always a power of two
+};
+
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+/*
+ * FNV-1a hash of the first len characters of url
+ */
+static uint32_t hashUrl(const char *url, int len) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h ^= (unsigned char) url[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+UrlTable UrlTableNew(void) {
+    UrlTable t = checkAlloc(malloc(sizeof(*t)));
+
+    t->size = 0;
+    t->cap = 0;
+    t->offset = NULL;
+    t->length = NULL;
+    t->hash = NULL;
+
+    t->arenaCap = INITIAL_ARENA;
+    t->arenaUsed = 0;
+    t->arena = checkAlloc(malloc(t->arenaCap));
+
+    t->numSlots = INITIAL_SLOTS;
+    t->slots = checkAlloc(malloc(t->numSlots * sizeof(int)));
+    for (int i = 0; i < t->numSlots; i++) {
+        t->slots[i] = EMPTY_SLOT;
+    }
+
+    return t;
+}
+
+void UrlTableFree(UrlTable t) {
+    free(t->offset);
+    free(t->length);
+    free(t->hash);
+    free(t->arena);
+    free(t->slots);
+    free(t);
+}
+
+/*
+ * Return the slot that holds the url, or the empty slot where it would go
+ */
+static int findSlot(UrlTable t, const char *url, int len, uint32_t h) {
+    int mask = t->numSlots - 1;
+    int i = h & mask;
+
+    while (t->slots[i] != EMPTY_SLOT) {
+        int id = t->slots[i];
+        if (
+            t->hash[id] == h && t->length[id] == len &&
+            memcmp(t->arena + t->offset[id], url, len) == 0
+        ) {
+            break;
+        }
+
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+/*
+ * Double the number of slots once they are half full
+ */
+static void growSlots(UrlTable t) {
+    free(t->slots);
+    t->numSlots *= 2;
+    t->slots = checkAlloc(malloc(t->numSlots * sizeof(int)));
+    for (int i = 0; i < t->numSlots; i++) {
+        t->slots[i] = EMPTY_SLOT;
+    }
+
+    int mask = t->numSlots - 1;
+    for (int id = 0; id < t->size; id++) {
+        int i = t->hash[id] & mask;
+        while (t->slots[i] != EMPTY_SLOT) {
+            i = (i + 1) & mask;
+        }
+        t->slots[i] = id;
+    }
+}
+
+int UrlTableIntern(UrlTable t, const char *url, int len) {
+    assert(len >= 0);
+
+    uint32_t h = hashUrl(url, len);
+    int slot = findSlot(t, url, len, h);
+    if (t->slots[slot] != EMPTY_SLOT) {
+        return t->slots[slot];
+    }
+
+    if (t->size == t->cap) {
+        t->cap = t->cap == 0 ? 16 : t->cap * 2;
+        t->offset = checkAlloc(realloc(t->offset, t->cap * sizeof(size_t)));
+        t->length = checkAlloc(realloc(t->length, t->cap * sizeof(int)));
+        t->hash = checkAlloc(realloc(t->hash, t->cap * sizeof(uint32_t)));
+    }
+
+    while (t->arenaUsed + len + 1 > t->arenaCap) {
+        t->arenaCap *= 2;
+        t->arena = checkAlloc(realloc(t->arena, t->arenaCap));
+    }
+
+    int id = t->size++;
+    t->offset[id] = t->arenaUsed;
+    t->length[id] = len;
+    t->hash[id] = h;
+    memcpy(t->arena + t->arenaUsed, url, len);
+    t->arena[t->arenaUsed + len] = '\0';
+    t->arenaUsed += len + 1;
+
+    t->slots[slot] = id;
+    if (t->size * 2 > t->numSlots) {
+        growSlots(t);
+    }
+
+    return id;
+}
+
+int UrlTableLookup(UrlTable t, const char *url, int len) {
+    return t->slots[findSlot(t, url, len, hashUrl(url, len))];
+}
+
+const char *UrlTableName(UrlTable t, int id) {
+    assert(id >= 0 && id < t->size);
+    return t->arena + t->offset[id];
+}
+
+int UrlTableNameLength(UrlTable t, int id) {
+    assert(id >= 0 && id < t->size);
+    return t->length[id];
+}
+
+int UrlTableSize(UrlTable t) {
+    return t->size;
+}
@@ -0,0 +1,51 @@
+// UrlTable.h - Interface to the url intern table
+
+// Written by: Bianca Ren
+// Date: 7th Nov 2022
+
+#ifndef URLTABLE_H
+#define URLTABLE_H
+
+typedef struct urlTableRep *UrlTable;
+
+/**
+ * Creates a new, empty url table.
+ */
+UrlTable UrlTableNew(void);
+
+/**
+ * Frees all memory associated with the table, including every name.
+ */
+void UrlTableFree(UrlTable t);
+
+/**
+ * Returns the id of the first `len` characters of url, adding it to the
+ * table if it isn't there yet. Ids are dense: the n-th distinct url gets
+ * id n - 1. The url doesn't need to be nul-terminated.
+ */
+int UrlTableIntern(UrlTable t, const char *url, int len);
+
+/**
+ * Returns the id of the first `len` characters of url, or -1 if the url
+ * was never added.
+ */
+int UrlTableLookup(UrlTable t, const char *url, int len);
+
+/**
+ * Returns the nul-terminated name of the given id. The name lives in the
+ * table's string arena, so the pointer is only valid until the next url
+ * is added.
+ */
+const char *UrlTableName(UrlTable t, int id);
+
+/**
+ * Returns the length of the name of the given id.
+ */
+int UrlTableNameLength(UrlTable t, int id);
+
+/**
+ * Returns the number of distinct urls in the table.
+ */
+int UrlTableSize(UrlTable t);
+
+#endif
@@ -0,0 +1,504 @@
+#!/bin/sh
+# check.sh - Runs the programs on the sample directories and compares
+# what they print with the expected output kept next to the samples
+#
+# Usage: ./check.sh binDir
+# where binDir holds pageRank, searchPageRank and scaledFootrule (make
+# check builds them there). Every check runs in a scratch copy of its
+# sample directory, so no binary files are left in the samples.
+
+# Written by: Bianca Ren
+# Date: 15th Nov 2022
+
+if [ $# -ne 1 ]; then
+    echo "Usage: $0 binDir" >&2
+    exit 1
+fi
+
+BIN=$(cd "$1" && pwd)
+HERE=$(cd "$(dirname "$0")" && pwd)
+SCRATCH=$(mktemp -d)
+trap 'rm -rf "$SCRATCH"' EXIT
+failures=0
+
+# expect name expectedFile actualFile
+expect() {
+    if cmp -s "$2" "$3"; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1"
+        diff "$2" "$3" | head -20
+        failures=$((failures + 1))
+    fi
+}
+
+# normalise file: the lines of the file with runs of blanks squeezed, 
+# no blanks at either end, and no empty lines
+normalise() {
+    tr -s ' \t' '  ' < "$1" | sed 's/^ //; s/ $//' | grep -v '^$'
+}
+
+# expectOneOf name actualFile expectedFile...: the sample has one or 
+# more equally good answers, compared after normalising
+expectOneOf() {
+    name=$1
+    normalise "$2" > "$SCRATCH/actual.txt"
+    shift 2
+    for exp in "$@"; do
+        if normalise "$exp" | cmp -s - "$SCRATCH/actual.txt"; then
+            echo "ok   $name"
+            return
+        fi
+    done
+
+    echo "FAIL $name"
+    cat "$SCRATCH/actual.txt"
+    failures=$((failures + 1))
+}
+
+# scribble file at [count]: overwrite count bytes (1 by default) at
+# offset `at` with 0xff
+scribble() {
+    i=0
+    while [ "$i" -lt "${3:-1}" ]; do
+        printf '\377'
+        i=$((i + 1))
+    done | dd of="$1" bs=1 seek="$2" conv=notrunc 2> /dev/null
+}
+
+# uint64At file at: the little-endian 64-bit number at offset `at`
+uint64At() {
+    od -An -t u8 -j "$2" -N 8 "$1" | tr -d ' '
+}
+
+# scratch sampleDir: start over with a fresh copy of the sample
+scratch() {
+    rm -rf "$SCRATCH/sample"
+    cp -R "$HERE/$1" "$SCRATCH/sample"
+    cd "$SCRATCH/sample" || exit 1
+}
+
+# collection numUrls: write a made-up collection into the current 
+# directory, with up to 13 links from every page, enough for the rank
+# sweep to be cut into many chunks
+collection() {
+    awk -v n="$1" 'BEGIN {
+        for (i = 0; i < n; i++) {
+            printf "url%d ", i > "collection.txt"
+        }
+        for (i = 0; i < n; i++) {
+            page = "url" i ".txt"
+            print "#start Section-1" > page
+            for (j = 1; j <= i * 7 % 13 + 1; j++) {
+                printf "url%d ", (i * 31 + j * j * 97) % n > page
+            }
+            print "\n#end Section-1\n\n#start Section-2" > page
+            print "word" i % 50 "\n#end Section-2" > page
+            close(page)
+        }
+    }'
+}
+
+# answer every line of queries.txt with searchPageRank, each answer
+# followed by an empty line like the --serve responses
+search() {
+    while IFS= read -r query; do
+        # the words of a query are separate arguments
+        # shellcheck disable=SC2086
+        "$BIN/searchPageRank" $query || echo "exit status $?"
+        echo
+    done < queries.txt
+}
+
+# --- pageRank and its --index -------------------------------------------
+
+cd "$HERE"
+for d in part1/*/; do
+    d=${d%/}
+    n=${d#part1/}
+
+    scratch "$d"
+    "$BIN/pageRank" 0.85 0.00001 1000 > out.txt
+    expectOneOf "$d ranks" out.txt "$HERE/$d/exp.txt"
+
+    # the chunks' diffs are added up in chunk order, so the ranks are 
+    # the same for any number of threads
+    for threads in 2 3 8; do
+        "$BIN/pageRank" 0.85 0.00001 1000 --threads "$threads" \
+            > threads.txt
+        expect "$d ranks with $threads threads" out.txt threads.txt
+    done
+
+    # the index built alongside the graph is the sample index of the
+    # same collection, give or take its blank lines and line order
+    "$BIN/pageRank" 0.85 0.00001 1000 --index index.txt > out.txt
+    expectOneOf "$d ranks with --index" out.txt "$HERE/$d/exp.txt"
+    normalise "$HERE/part2/$n/invertedIndex.txt" | LC_ALL=C sort > exp.txt
+    expect "$d --index" exp.txt index.txt
+
+    "$BIN/pageRank" 0.85 0.00001 1000 --index threads.txt --threads 3 \
+        > out.txt
+    expect "$d --index with 3 threads" index.txt threads.txt
+done
+
+# a link repeated on a page, even after other links, is one edge
+scratch part1/01
+sed 's/url21 url22 url23/url21 url22 url21 url23 url22/' url11.txt \
+    > repeated.txt
+mv repeated.txt url11.txt
+"$BIN/pageRank" 0.85 0.00001 1000 > out.txt
+expectOneOf "part1/01 ranks with repeated links" out.txt \
+    "$HERE/part1/01/exp.txt"
+
+# --- pageRank --threads and --kernel on a collection of many chunks ----
+
+rm -rf "$SCRATCH/sample"
+mkdir "$SCRATCH/sample"
+cd "$SCRATCH/sample" || exit 1
+collection 5000
+"$BIN/pageRank" 0.85 0.00001 1000 > out.txt
+for threads in 2 3 8; do
+    "$BIN/pageRank" 0.85 0.00001 1000 --threads "$threads" > threads.txt
+    expect "5000 urls ranks with $threads threads" out.txt threads.txt
+done
+
+# every vector kernel has to give the scalar kernel's ranks to the bit;
+# the ones this cpu doesn't have can't be checked here
+for kernel in scalar avx2 avx512; do
+    if "$BIN/pageRank" 0.85 0.00001 1000 --kernel "$kernel" > kernel.txt \
+        2> /dev/null; then
+        expect "5000 urls ranks with the $kernel kernel" out.txt kernel.txt
+    else
+        echo "skip 5000 urls ranks with the $kernel kernel"
+    fi
+done
+
+# --- pageRank's other ways of iterating ---------------------------------
+
+cd "$HERE"
+for d in part1/*/; do
+    d=${d%/}
+
+    # they stop at other iterations, so the ranks differ in the last 
+    # digits, but the pages have to come out in the same order
+    scratch "$d"
+    "$BIN/pageRank" 0.85 0.00001 1000 | awk '{ print $1 }' > order.txt
+    for order in natural degree topo; do
+        "$BIN/pageRank" 0.85 0.00001 1000 --schedule gauss-seidel \
+            --order "$order" | awk '{ print $1 }' > out.txt
+        expect "$d gauss-seidel in $order order" order.txt out.txt
+    done
+
+    for method in aitken quadratic; do
+        "$BIN/pageRank" 0.85 0.00001 1000 --extrapolate "$method" | 
+            awk '{ print $1 }' > out.txt
+        expect "$d $method extrapolation" order.txt out.txt
+    done
+
+    # urls are frozen after one calm iteration (part1/01 freezes some),
+    # with and without the full sweeps that wake them all up
+    for sweeps in 10 0; do
+        "$BIN/pageRank" 0.85 0.00001 1000 --adaptive 1 \
+            --full-sweep "$sweeps" | awk '{ print $1 }' > out.txt
+        expect "$d adaptive with --full-sweep $sweeps" order.txt out.txt
+    done
+
+    # --stable-top only vouches for the order of the top pages
+    for top in 1 3; do
+        "$BIN/pageRank" 0.85 0.00001 1000 --stable-top "$top" \
+            --stable-for 2 | awk '{ print $1 }' | head -n "$top" > out.txt
+        head -n "$top" order.txt > exp.txt
+        expect "$d stable top $top" exp.txt out.txt
+    done
+
+    # --compare measures the iterations it saved against a full run, the
+    # difference between the two runs' counts, next to the estimate
+    "$BIN/pageRank" 0.85 0.00001 1000 --stable-top 3 --compare \
+        2> compare.txt > /dev/null
+    early=$(sed -n 's/^jacobi: \([0-9]*\) iterations.*stable.*/\1/p' \
+        compare.txt)
+    full=$(sed -n '/stable/!s/^jacobi: \([0-9]*\) iterations.*/\1/p' \
+        compare.txt)
+    echo "stopped $((full - early)) iterations before jacobi reached diffPR" \
+        > exp.txt
+    sed -n 's/ (estimated [0-9]*)$//p' compare.txt > out.txt
+    expect "$d stable top 3 measured against jacobi" exp.txt out.txt
+done
+
+# --- pageRank --archive -------------------------------------------------
+
+cd "$HERE"
+for d in part1/*/; do
+    d=${d%/}
+
+    # the pages are only read from the archive once it is packed
+    scratch "$d"
+    "$BIN/pageRank" pack
+    rm -f collection.txt url*.txt
+    "$BIN/pageRank" 0.85 0.00001 1000 --archive collection.pack > out.txt
+    expectOneOf "$d --archive" out.txt "$HERE/$d/exp.txt"
+
+    # packing again without a page fails and keeps the earlier archive
+    cp collection.pack keep.pack
+    cp "$HERE/$d/collection.txt" .
+    "$BIN/pageRank" pack 2> /dev/null
+    echo "exit status $? $(ls ./*.tmp 2> /dev/null)" > out.txt
+    echo "exit status 1 " > exp.txt
+    expect "$d pack without a page" exp.txt out.txt
+    expect "$d pack without a page keeps the archive" keep.pack \
+        collection.pack
+    rm collection.txt keep.pack
+
+    "$BIN/pageRank" 0.85 0.00001 1000 --archive collection.pack \
+        --threads 3 > out.txt
+    expectOneOf "$d --archive with 3 threads" out.txt "$HERE/$d/exp.txt"
+
+    # a damaged archive is refused as a whole, never read out of bounds:
+    # cut short, a bad magic, a collection offset that wraps around and
+    # a first page past the end of the file
+    mv collection.pack good.pack
+    echo "Can't open bad.pack" > exp.txt
+    pages=$(uint64At good.pack 40)
+    for damage in "cut" "0 1" "16 8" "$pages 8"; do
+        if [ "$damage" = "cut" ]; then
+            head -c 40 good.pack > bad.pack
+        else
+            cp good.pack bad.pack
+            # shellcheck disable=SC2086
+            scribble bad.pack $damage
+        fi
+
+        "$BIN/pageRank" 0.85 0.00001 1000 --archive bad.pack \
+            > /dev/null 2> err.txt
+        expect "$d damaged archive ($damage)" exp.txt err.txt
+    done
+done
+
+# --- pageRank --binary and searchPageRank's use of it --------------------
+
+cd "$HERE"
+for d in part1/*/; do
+    d=${d%/}
+    n=${d#part1/}
+
+    # the search answers from the rank table must be those from the text
+    # list; the text list is emptied, so only the table can give them
+    scratch "$d"
+    cp "$HERE/part2/$n/queries.txt" .
+    "$BIN/pageRank" 0.85 0.00001 1000 --index invertedIndex.txt \
+        --binary table.bin > pageRankList.txt
+    search > text.txt
+    cp pageRankList.txt list.txt
+    : > pageRankList.txt
+    touch -t 200001010000 pageRankList.txt
+    cp table.bin pageRankList.bin
+    search > out.txt
+    expect "$d rank table" text.txt out.txt
+
+    # a damaged table is ignored for the text list: cut short, a bad 
+    # magic, the first alphabetical rank and the first name offset 
+    # out of range
+    lexRanks=$(uint64At table.bin 32)
+    names=$(uint64At table.bin 40)
+    for damage in "cut" "0 1" "$lexRanks 4" "$names 4"; do
+        cp list.txt pageRankList.txt
+        if [ "$damage" = "cut" ]; then
+            head -c 60 table.bin > pageRankList.bin
+        else
+            cp table.bin pageRankList.bin
+            # shellcheck disable=SC2086
+            scribble pageRankList.bin $damage
+        fi
+
+        search > out.txt
+        expect "$d damaged rank table ($damage)" text.txt out.txt
+    done
+done
+
+# --- searchPageRank: text and compiled inverted index -------------------
+
+cd "$HERE"
+for d in part2/*/; do
+    d=${d%/}
+
+    scratch "$d"
+    search > out.txt
+    expect "$d text index" "$HERE/$d/exp.txt" out.txt
+
+    "$BIN/searchPageRank" --compile
+    search > out.txt
+    expect "$d compiled index" "$HERE/$d/exp.txt" out.txt
+
+    # the index is kept, but the rank list is reordered under it and
+    # given an older time, so only the url order can tell it's stale
+    awk 'NF == 3' pageRankList.txt | sort > ranks.txt
+    awk 'NF != 3' pageRankList.txt >> ranks.txt
+    mv ranks.txt pageRankList.txt
+    touch -t 200001010000 pageRankList.txt
+    search > out.txt
+    mv invertedIndex.bin stale.bin
+    search > text.txt
+    expect "$d stale compiled index" text.txt out.txt
+
+    # the text index is edited in place within the second the index was
+    # compiled, and given the index's time, so the time alone can't tell
+    scratch "$d"
+    "$BIN/searchPageRank" --compile
+    awk '{ $NF = ""; print }' invertedIndex.txt > text.txt
+    cat text.txt > invertedIndex.txt
+    touch -r invertedIndex.bin invertedIndex.txt
+    search > out.txt
+    mv invertedIndex.bin stale.bin
+    search > text.txt
+    expect "$d compiled index of an edited text index" text.txt out.txt
+
+    # a cut short or scribbled on index has to be ignored, not read
+    scratch "$d"
+    "$BIN/searchPageRank" --compile
+    head -c 100 invertedIndex.bin > cut.bin
+    mv cut.bin invertedIndex.bin
+    search > out.txt
+    expect "$d truncated compiled index" "$HERE/$d/exp.txt" out.txt
+
+    "$BIN/searchPageRank" --compile
+    mv invertedIndex.bin good.bin
+    size=$(wc -c < good.bin)
+    for at in 60 90 $((size - 3)) $((size - 1)); do
+        cp good.bin invertedIndex.bin
+        scribble invertedIndex.bin "$at"
+        search > out.txt
+        expect "$d corrupt compiled index (byte $at)" \
+            "$HERE/$d/exp.txt" out.txt
+    done
+done
+
+# --- searchPageRank --serve ---------------------------------------------
+
+cd "$HERE"
+for d in part2/*/; do
+    d=${d%/}
+
+    scratch "$d"
+    "$BIN/searchPageRank" --serve < queries.txt > out.txt
+    expect "$d serve" "$HERE/$d/exp.txt" out.txt
+
+    "$BIN/searchPageRank" --serve --threads 3 < queries.txt > out.txt
+    expect "$d serve with 3 threads" "$HERE/$d/exp.txt" out.txt
+
+    # the server checks the whole index once, so a damaged entry of a 
+    # term no query uses still sends it back to the text index
+    "$BIN/searchPageRank" --compile
+    scribble invertedIndex.bin $(($(wc -c < invertedIndex.bin) - 1))
+    "$BIN/searchPageRank" --serve < queries.txt > out.txt
+    expect "$d serve with a corrupt compiled index" "$HERE/$d/exp.txt" \
+        out.txt
+    rm invertedIndex.bin
+
+    # blank lines get an empty answer and aren't counted as queries
+    printf 'mars\n\n  \ndesign\n#stats\n' |
+        "$BIN/searchPageRank" --serve | grep '^queries' > out.txt
+    echo "queries 2" > exp.txt
+    expect "$d serve stats" exp.txt out.txt
+
+    # a file that isn't a socket is never replaced, and the server
+    # refuses to start rather than listening there
+    echo "not a socket" > file.txt
+    cp file.txt keep.txt
+    timeout 5 "$BIN/searchPageRank" --serve file.txt 2> /dev/null
+    expect "$d serve leaves files alone" keep.txt file.txt
+done
+
+# responses that can't be written stop the server with a failure
+scratch part2/01
+"$BIN/searchPageRank" --serve < queries.txt > /dev/full 2> /dev/null
+echo "exit status $?" > out.txt
+echo "exit status 1" > exp.txt
+expect "part2/01 serve into a full disk" exp.txt out.txt
+
+# a second server doesn't take over the socket of one that listens, but
+# the socket a killed server left behind is taken over and served on
+"$BIN/searchPageRank" --serve query.sock &
+server=$!
+tries=0
+while [ ! -S query.sock ] && [ "$tries" -lt 100 ]; do
+    sleep 0.1
+    tries=$((tries + 1))
+done
+timeout 5 "$BIN/searchPageRank" --serve query.sock 2> /dev/null
+echo "exit status $?" > out.txt
+kill -KILL "$server"
+wait "$server" 2> /dev/null
+expect "part2/01 serve leaves a listening socket alone" exp.txt out.txt
+
+# timeout stops the server that is still serving
+timeout 1 "$BIN/searchPageRank" --serve query.sock 2> /dev/null
+echo "exit status $?" > out.txt
+echo "exit status 124" > exp.txt
+expect "part2/01 serve replaces a stale socket" exp.txt out.txt
+
+# --- scaledFootrule --exhaustive ----------------------------------------
+
+cd "$HERE"
+for d in part3/*/; do
+    d=${d%/}
+
+    scratch "$d"
+    "$BIN/scaledFootrule" --exhaustive rank*.txt > out.txt
+    expectOneOf "$d exhaustive" out.txt "$HERE/$d"/exp*.txt
+
+    # subtrees are combined in order, so threads can't change the answer
+    "$BIN/scaledFootrule" --exhaustive --threads 4 rank*.txt > threads.txt
+    expect "$d exhaustive with 4 threads" out.txt threads.txt
+done
+
+# --- scaledFootrule: assignment against exhaustive search ---------------
+
+cd "$HERE"
+for d in part3/*/; do
+    d=${d%/}
+
+    scratch "$d"
+    "$BIN/scaledFootrule" rank*.txt > out.txt
+    expectOneOf "$d assignment" out.txt "$HERE/$d"/exp*.txt
+
+    # several rankings can share the smallest distance, and the tie has
+    # to go the same way as in the exhaustive search
+    "$BIN/scaledFootrule" --exhaustive rank*.txt > exhaustive.txt
+    expect "$d assignment matches exhaustive" exhaustive.txt out.txt
+done
+
+# --- scaledFootrule --heuristic -----------------------------------------
+
+cd "$HERE"
+for d in part3/*/; do
+    d=${d%/}
+
+    # on a handful of urls the local search ends at the optimum
+    scratch "$d"
+    "$BIN/scaledFootrule" --heuristic rank*.txt 2> /dev/null > out.txt
+    "$BIN/scaledFootrule" --exhaustive rank*.txt > exhaustive.txt
+    head -n 1 exhaustive.txt > exp.txt
+    head -n 1 out.txt > dist.txt
+    expect "$d heuristic distance matches exhaustive" exp.txt dist.txt
+done
+
+# a ranking and its reverse leave every url free between its two
+# positions, so the seed's medians all tie and the order of the first
+# ranking, which is optimal, has to be kept
+rm -rf "$SCRATCH/sample"
+mkdir "$SCRATCH/sample"
+cd "$SCRATCH/sample" || exit 1
+awk 'BEGIN { for (i = 1; i <= 1000; i++) print "url" i }' > rankA.txt
+awk 'BEGIN { for (i = 1000; i >= 1; i--) print "url" i }' > rankB.txt
+"$BIN/scaledFootrule" --heuristic rankA.txt rankB.txt 2> gap.txt > out.txt
+grep -o 'gap [0-9.]*' gap.txt > dist.txt
+echo "gap 0.0000000" > exp.txt
+expect "1000 urls and their reverse heuristic reaches the bound" exp.txt \
+    dist.txt
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures check(s) failed"
+    exit 1
+fi
+
+echo "all checks passed"
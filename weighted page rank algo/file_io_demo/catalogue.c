@@ -1,12 +1,12 @@
-// Demonstration of fscanf
+// Demonstration of the Reader module
 // Prints out catalogue from products listed in products.txt
-// Assumes product names are no longer than MAX_PRODUCT_NAME
+// Product names can be any length
 // Usage: ./catalogue products.txt
 
 #include <stdio.h>
 #include <stdlib.h>
 
-#define MAX_PRODUCT_NAME 20
+#include "Reader.h"
 
 int main(int argc, char *argv[]) {
 	if (argc != 2) {
@@ -14,24 +14,28 @@ int main(int argc, char *argv[]) {
 		exit(EXIT_FAILURE);
 	}
 
-	// See linenos.c for description of fopen and fclose
-	FILE *fp = fopen(argv[1], "r");
-	if (fp == NULL) {
+	// See linenos.c for description of ReaderOpen and ReaderClose
+	Reader r = ReaderOpen(argv[1]);
+	if (r == NULL) {
 		fprintf(stderr, "Can't open %s\n", argv[1]);
 		exit(EXIT_FAILURE);
 	}
 
-	char name[MAX_PRODUCT_NAME];
+	Span name;
 	int quantity;
 	double price;
 
-	// fscanf works similarly to scanf, except it reads from a file.
-	// It takes a file pointer as its first argument. The remaining
-	// arguments are the same as what you would pass to scanf.
-	while (fscanf(fp, "%s %d %lf", name, &quantity, &price) == 3) {
-		printf("%d %s(s) for sale at $%.2lf each\n", quantity, name, price);
+	// Each call reads the next whitespace separated word, the way
+	// fscanf(fp, "%s %d %lf", ...) would. The name is not copied: the 
+	// span points into the file, so it is printed with its length.
+	while (
+		ReaderToken(r, &name) && ReaderInt(r, &quantity) && 
+		ReaderDouble(r, &price)
+	) {
+		printf("%d %.*s(s) for sale at $%.2lf each\n", quantity, 
+		       (int) name.len, name.start, price);
 	}
 
-	fclose(fp);
+	ReaderClose(r);
 }
 
@@ -1,35 +1,31 @@
-// Demonstration of fgets
+// Demonstration of the Reader module's lines
 // Prints out a file with line numbers
-// Assumes lines are no longer than MAX_LINE_LENGTH
+// Lines can be any length
 // Usage: ./linenos [File]
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
-#define MAX_LINE_LENGTH 128
+#include "Reader.h"
 
 int main(int argc, char *argv[]) {
-	FILE *fp;
+	Reader r;
 	if (argc == 1) {
-		fp = stdin;
+		// Standard input can't be mapped, so it is read to the end
+		// first: no line is printed until the input is closed
+		r = ReaderFromFd(STDIN_FILENO);
 	} else if (argc == 2) {
-		// fopen takes two strings: a filename and an access mode. The
-		// filename is simply the name of the file that should be opened.
-		// The access mode determines whether the file should be opened for
-		// reading or writing (or both) and if opened for writing whether
-		// the file should be truncated (emptied) first.
+		// ReaderOpen takes a filename and opens it for reading. A regular
+		// file is mapped into memory, so reading it copies nothing.
+		r = ReaderOpen(argv[1]);
 
-		// Here we open the file given in the first command-line argument
-		// for reading.
-		fp = fopen(argv[1], "r");
-
-		// fopen can fail for a number of reasons:
+		// ReaderOpen can fail for a number of reasons:
 		// - the file doesn't exist
-		// - the user does not have permission to open it in the given mode
+		// - the user does not have permission to read it
 		// - the open file limit has been reached
-		// If fopen fails, it will return NULL. Otherwise, it will return a file
-		// pointer, which you can pass into other file handling functions.
-		if (fp == NULL) {
+		// If ReaderOpen fails, it will return NULL.
+		if (r == NULL) {
 			fprintf(stderr, "Can't open %s\n", argv[1]);
 			exit(EXIT_FAILURE);
 		}
@@ -38,23 +34,20 @@ int main(int argc, char *argv[]) {
 		exit(EXIT_FAILURE);
 	}
 
-	char line[MAX_LINE_LENGTH + 1];
+	Span line;
 	int lineNo = 1;
 
-	// fgets takes a string buffer, a size and a file pointer. It reads
-	// characters into the given buffer until it has read in `size - 1`
-	// characters or a newline, whichever occurs first. The newline is
-	// included. A null terminator is added after the last character is
-	// read in.
-	// If fp is already at the end of the file, fgets will return NULL.
-	while (fgets(line, MAX_LINE_LENGTH + 1, fp) != NULL) {
+	// ReaderLine gives the next line, newline included, however long it
+	// is. The line is not nul-terminated, so it is printed with its
+	// length. At the end of the file, ReaderLine returns false.
+	while (ReaderLine(r, &line)) {
 		printf("%d ", lineNo);
-		printf("%s", line);
+		fwrite(line.start, 1, line.len, stdout);
 		lineNo++;
 	}
 
-	// fclose closes the given file. Not closing a file will lead to memory
-	// leaks. A file pointer can no longer be used after it is closed.
-	fclose(fp);
+	// ReaderClose releases the file. Not closing a reader will lead to 
+	// memory leaks, and its lines can no longer be used after it is closed.
+	ReaderClose(r);
 }
 
@@ -5,43 +5,330 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <float.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include "Archive.h"
 #include "Graph.h"
 #include "List.h"
+#include "RankKernel.h"
+#include "Reader.h"
+#include "Sort.h"
+#include "ThreadPool.h"
+#include "UrlTable.h"
 
 #define MAX_URL_LENGTH 104
+// rank vectors are aligned to (and padded out to) a cache line
+#define RANK_ALIGNMENT 64
+// number of rank vectors kept: the previous and the current iteration
+#define RANK_HISTORY 2
+// vectors kept when extrapolating: quadratic extrapolation needs four
+#define EXTRAPOLATION_HISTORY 4
+// plain iterations between two extrapolations, at least 3
+#define EXTRAPOLATION_PERIOD 6
+// iterations between two full sweeps of an adaptive run
+#define ADAPTIVE_FULL_SWEEP 10
+// iterations the top pages have to hold still for --stable-top to stop
+#define STABLE_TOP_ITERATIONS 3
+// work (one per url plus one per in-link) that makes up a chunk of urls
+#define CHUNK_WORK 4096
+// pages a worker reads at a time while loading the collection
+#define INGEST_CHUNK 64
+// bytes copied by --bench to measure the memory bandwidth
+#define BENCH_BYTES (64 << 20)
 typedef struct pageRankRep *PR;
 
 const char *const txtFileExtent = ".txt";
 const char *const start = "#start";
 const char *const end = "#end";
 const char *const section = "Section-1";
+const char *const wordSection = "Section-2";
+// trailing punctuation removed from the words of a page
+const char *const wordPunctuation = ".,;?";
 
+// A ring of numKept rank vectors, stored back to back in one aligned
+// block. Slot `newest` holds the latest iteration and the slots before it
+// (wrapping around) hold older ones, so with two slots advancing is a swap
 struct pageRankRep {
-    double **weight;
+    double *ranks;
     int numUrl;
-    int numIter;
+    int stride;     // doubles per vector, numUrl padded to RANK_ALIGNMENT
+    int numKept;
+    int newest;
+    int numIter;    // iterations completed so far
 };
 
-PR newPageRank(int urls, int iterations);
+// One iteration split into chunks of consecutive urls. Chunk boundaries
+// only depend on the graph, never on the number of workers, and every
+// chunk keeps its own part of the diff, which are added up in chunk
+// order. So the ranks come out the same for any number of threads
+struct rankSweep {
+    RankInput input;
+    RankKernel kernel;  // the fastest the cpu has unless --kernel says
+    const double *prev;
+    double *curr;
+
+    int numChunks;
+    int *chunkStart;    // first url of each chunk, plus numUrls at the end
+    int *workerChunk;   // first chunk of each worker, plus numChunks
+    double *chunkDiff;
+};
+
+// How weightPageRank updates the ranks each iteration
+enum rankSchedule {
+    SCHEDULE_JACOBI,        // every url reads the previous iteration
+    SCHEDULE_GAUSS_SEIDEL,  // every url reads the freshest ranks, in place
+    NUM_SCHEDULES
+};
+
+// The order of the urls in a Gauss-Seidel sweep
+enum rankOrder {
+    ORDER_NATURAL,          // collection order
+    ORDER_DEGREE,           // most out-links first
+    ORDER_TOPO,             // linking pages before linked ones, if acyclic
+    NUM_ORDERS
+};
+
+// How weightPageRank jumps ahead of the iterations now and then
+enum rankExtrapolation {
+    EXTRAPOLATE_NONE,
+    EXTRAPOLATE_AITKEN,     // Aitken's delta-squared, url by url
+    EXTRAPOLATE_QUADRATIC,  // quadratic extrapolation over 4 iterations
+    NUM_EXTRAPOLATIONS
+};
+
+const char *const scheduleNames[NUM_SCHEDULES] = { 
+    "jacobi", "gauss-seidel" 
+};
+const char *const orderNames[NUM_ORDERS] = { "natural", "degree", "topo" };
+const char *const extrapolationNames[NUM_EXTRAPOLATIONS] = { 
+    "none", "aitken", "quadratic" 
+};
+
+struct rankOptions {
+    double d;
+    double diffPR;
+    int maxIterations;
+    enum rankSchedule schedule;
+    enum rankOrder order;
+    enum rankExtrapolation extrapolation;
+    int freezeAfter;        // --adaptive: calm iterations before a freeze
+    int fullSweep;          // --adaptive: iterations between full sweeps
+    int stableTop;          // --stable-top: pages whose order is watched
+    int stableFor;          // --stable-top: iterations it has to hold
+    const int *lexRank;     // --stable-top: alphabetical rank of each url
+    RankKernel kernel;      // Jacobi sweep, the fastest unless --kernel
+};
+
+// What one run of weightPageRank took
+struct rankStats {
+    int iterations;
+    int sweeps;             // iterations plus the extrapolations' checks
+    int extrapolations;     // extrapolations tried
+    int kept;               // extrapolations that lowered the diff
+    double seconds;
+    double diff;            // the last iteration's diff
+    long updates;           // urls recomputed over all the iterations
+    int numUrls;
+    bool stable;            // stopped early because the top pages held
+    int saved;              // estimate of the iterations diffPR would 
+                            // have taken on top, from the last diff
+};
+
+// The top pages of an iteration, watched for --stable-top. They are 
+// stable when the order of the best k, and the page right after them, 
+// is the same as in the last iteration, and the gap between the kth and 
+// the next page is wider than those two pages just moved.
+// --stable-top trades accuracy for time: it stops on the order of the
+// top pages, while every rank, those pages' included, can still be 
+// further than diffPR from where diffPR would have stopped, and the 
+// ranks are printed as they are
+struct topWatch {
+    int k;
+    int kept;           // pages in best and last: k + 1, or every url
+    RankKey *keys;      // every url, refilled each iteration
+    RankKey *best;      // this iteration's top pages, best first
+    int *last;          // the last iteration's top pages
+    int stable;         // iterations in a row the top pages were stable
+};
+
+// Per-url state of an adaptive run. A url is frozen, and keeps its rank,
+// once it has moved less than tolerance for freezeAfter iterations in a
+// row. A frozen url is only recomputed when one of its in-links moves by
+// more than that, or in a full sweep, which recomputes every url
+struct adaptive {
+    int freezeAfter;
+    int fullSweep;      // iterations between two full sweeps, 0 for none
+    double tolerance;
+    int *calm;          // iterations in a row each url moved < tolerance
+    int *woken;         // iteration in which a frozen url is recomputed
+    int *urls;          // the urls recomputed by the current iteration
+    bool full;          // whether the last iteration was a full sweep
+    long updates;
+};
+
+// A growable array of (x, y) pairs
+struct pairBuffer {
+    int *pairs;
+    int size;           // ints used, twice the number of pairs
+    int cap;
+};
+
+// What one chunk of pages holds: links as (src, dest) pairs and, when 
+// the inverted index is built, words as (src, word) pairs with word an
+// id in the chunk's own table
+struct pageChunk {
+    struct pairBuffer links;
+    struct pairBuffer words;
+    UrlTable terms;
+};
+
+// The collection's pages split into chunks of INGEST_CHUNK urls, read by
+// the workers in any order. Every chunk goes into the graph and the index
+// in chunk order, so both are built exactly as reading the pages one by
+// one would build them
+struct ingest {
+    List l;
+    Archive archive;    // the pages, or NULL to read the loose files
+    int numUrls;
+    bool withWords;
+    int numChunks;
+    int numWorkers;     // worker w reads chunks w, w + numWorkers, ...
+    struct pageChunk *chunks;
+};
+
+// What one worker reuses from page to page, so reading a page allocates
+// nothing
+struct ingestScratch {
+    int *linked;        // linked[dest] == src once src links to dest
+    char *word;         // the normalised word being interned
+    int wordCap;
+};
+
+// The inverted index: the pages every normalised word appears in
+struct wordIndex {
+    UrlTable terms;
+    struct pairBuffer *pages;   // pages[t].pairs holds urls, one per int
+};
+
+PR newPageRank(int urls, int history);
 void PageRankFree(PR pr);
-void weightPageRank(double d, double diffPR, int maxIterations, 
-                    int numUrls, Graph directUrl, List allUrls, PR pr);
-Graph linkUrl(List allUrls);
-Graph doLinkUrl(Graph directUrl, char url[MAX_URL_LENGTH], 
-                char urlFile[MAX_URL_LENGTH], List l);
-bool isLinkable(Graph directUrl, char srcUrl[MAX_URL_LENGTH], 
-                char destUrl[MAX_URL_LENGTH], List l);
+void pageRankAdvance(PR pr);
+double *pageRankHistory(PR pr, int age);
+void weightPageRank(const struct rankOptions *opt, Graph directUrl, PR pr,
+                    ThreadPool pool, struct rankStats *stats);
+void showStats(const struct rankOptions *opt, const struct rankStats *run);
+void compareWithJacobi(const struct rankOptions *opt, 
+                       const struct rankStats *run, Graph directUrl, 
+                       PR pr, ThreadPool pool);
+List archiveUrls(Archive archive);
+Graph linkUrl(List allUrls, Archive archive, ThreadPool pool, 
+              struct wordIndex *words);
+void doLinkUrl(struct pageChunk *out, struct ingestScratch *scratch, 
+               int src, Reader r, List l, bool withWords);
+bool isLinkable(int src, int dest, Span destUrl, List l);
+void writeWordIndex(struct wordIndex *words, List l, const char *path);
+void benchKernels(double d, Graph directUrl, int repeats);
+int nameIndex(const char *arg, const char *const *names, int n);
 
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s dampingFactor diffPR maxIterations\n",
-                argv[0]);
+    // bundle the collection into one archive and stop
+    if (argc >= 2 && argc <= 3 && strcmp(argv[1], "pack") == 0) {
+        const char *path = argc == 3 ? argv[2] : ARCHIVE_FILE;
+        if (!ArchivePack(path)) {
+            fprintf(stderr, "Can't write %s\n", path);
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
+
+    int numThreads = 1;
+    const char *indexPath = NULL;
+    const char *archivePath = NULL;
+    const char *binaryPath = NULL;
+    int benchRepeats = 0;
+    bool stats = false;
+    bool compare = false;
+    bool usage = argc < 4;
+
+    struct rankOptions opt;
+    opt.schedule = SCHEDULE_JACOBI;
+    opt.order = ORDER_NATURAL;
+    opt.extrapolation = EXTRAPOLATE_NONE;
+    opt.freezeAfter = 0;
+    opt.fullSweep = ADAPTIVE_FULL_SWEEP;
+    opt.stableTop = 0;
+    opt.stableFor = STABLE_TOP_ITERATIONS;
+    opt.lexRank = NULL;
+    opt.kernel = RankKernelBest();
+    bool ordered = false;
+    const char *kernelName = NULL;
+
+    for (int i = 4; i < argc && !usage; i++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+            numThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--index") == 0 && hasValue) {
+            indexPath = argv[++i];
+        } else if (strcmp(argv[i], "--archive") == 0 && hasValue) {
+            archivePath = argv[++i];
+        } else if (strcmp(argv[i], "--binary") == 0 && hasValue) {
+            binaryPath = argv[++i];
+        } else if (strcmp(argv[i], "--bench") == 0 && hasValue) {
+            benchRepeats = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--schedule") == 0 && hasValue) {
+            int k = nameIndex(argv[++i], scheduleNames, NUM_SCHEDULES);
+            opt.schedule = k;
+            usage = k == -1;
+        } else if (strcmp(argv[i], "--order") == 0 && hasValue) {
+            int k = nameIndex(argv[++i], orderNames, NUM_ORDERS);
+            opt.order = k;
+            ordered = true;
+            usage = k == -1;
+        } else if (strcmp(argv[i], "--extrapolate") == 0 && hasValue) {
+            int k = nameIndex(argv[++i], extrapolationNames, 
+                              NUM_EXTRAPOLATIONS);
+            opt.extrapolation = k;
+            usage = k == -1;
+        } else if (strcmp(argv[i], "--adaptive") == 0 && hasValue) {
+            opt.freezeAfter = atoi(argv[++i]);
+            usage = opt.freezeAfter < 1;
+        } else if (strcmp(argv[i], "--full-sweep") == 0 && hasValue) {
+            opt.fullSweep = atoi(argv[++i]);
+            usage = opt.fullSweep < 0;
+        } else if (strcmp(argv[i], "--stable-top") == 0 && hasValue) {
+            opt.stableTop = atoi(argv[++i]);
+            usage = opt.stableTop < 1;
+        } else if (strcmp(argv[i], "--stable-for") == 0 && hasValue) {
+            opt.stableFor = atoi(argv[++i]);
+            usage = opt.stableFor < 1;
+        } else if (strcmp(argv[i], "--kernel") == 0 && hasValue) {
+            kernelName = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (strcmp(argv[i], "--compare") == 0) {
+            compare = true;
+        } else {
+            usage = true;
+        }
+    }
+
+    if (usage) {
+        fprintf(stderr, "Usage: %s dampingFactor diffPR maxIterations "
+                "[--threads N] [--index invertedIndexFile] "
+                "[--archive archiveFile] [--binary rankTableFile] "
+                "[--bench repeats] [--schedule jacobi|gauss-seidel] "
+                "[--order natural|degree|topo] "
+                "[--extrapolate none|aitken|quadratic] "
+                "[--adaptive calmIterations] [--full-sweep iterations] "
+                "[--stable-top K] [--stable-for iterations] "
+                "[--kernel scalar|avx2|avx512] [--stats] [--compare]\n"
+                "       %s pack [archiveFile]\n", argv[0], argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -50,33 +337,145 @@ int main(int argc, char *argv[]) {
     int maxIterations = atoi(argv[3]);
     int numUrls;
 
-    List allUrls = urlsInList();
-    Graph directUrl = linkUrl(allUrls);
+    if (numThreads < 1) {
+        fprintf(stderr, "%s: --threads needs a positive number\n", argv[0]);
+        return EXIT_FAILURE;
+    } else if (
+        kernelName != NULL && !RankKernelNamed(kernelName, &opt.kernel)
+    ) {
+        fprintf(stderr, "%s: this cpu has no %s kernel\n", argv[0], 
+                kernelName);
+        return EXIT_FAILURE;
+    } else if (ordered && opt.schedule != SCHEDULE_GAUSS_SEIDEL) {
+        fprintf(stderr, "%s: --order needs --schedule gauss-seidel\n", 
+                argv[0]);
+        return EXIT_FAILURE;
+    } else if (opt.freezeAfter > 0 && opt.extrapolation != EXTRAPOLATE_NONE) {
+        fprintf(stderr, "%s: --adaptive can't be used with --extrapolate\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // a Gauss-Seidel sweep updates the ranks in place one url after the
+    // other, and an adaptive one only visits the urls still moving, so 
+    // only reading the pages can use the other threads
+    if (
+        numThreads > 1 && 
+        (opt.schedule == SCHEDULE_GAUSS_SEIDEL || opt.freezeAfter > 0)
+    ) {
+        fprintf(stderr, "%s: warning: %s iterates on one thread, "
+                "--threads only reads the pages in parallel\n", argv[0],
+                opt.freezeAfter > 0 ? "--adaptive" : 
+                                      "--schedule gauss-seidel");
+    }
+
+    // pages come from the archive when there is one, or their own files
+    Archive archive = NULL;
+    if (archivePath != NULL) {
+        archive = ArchiveOpen(archivePath);
+        if (archive == NULL) {
+            fprintf(stderr, "Can't open %s\n", archivePath);
+            return EXIT_FAILURE;
+        }
+    }
+
+    ThreadPool pool = PoolNew(numThreads);
+    List allUrls = archive ? archiveUrls(archive) : urlsInList();
+    // the index is built in the same pass over the pages as the graph
+    struct wordIndex words;
+    Graph directUrl = linkUrl(allUrls, archive, pool, 
+                              indexPath ? &words : NULL);
     updateAllOutDegree(directUrl, allUrls);
 
+    if (indexPath != NULL) {
+        writeWordIndex(&words, allUrls, indexPath);
+    }
+
     numUrls = GraphNumVertices(directUrl);
 
-    PR pr = newPageRank(numUrls, maxIterations);
-    weightPageRank(d, diffPR, maxIterations, numUrls, directUrl, allUrls, pr);
+    // --bench times the kernels on this graph instead of ranking it
+    if (benchRepeats > 0) {
+        benchKernels(d, directUrl, benchRepeats);
+        PoolFree(pool);
+        if (archive != NULL) {
+            ArchiveFree(archive);
+        }
+        GraphFree(directUrl);
+        ListFree(allUrls);
+        return 0;
+    }
+
+    opt.d = d;
+    opt.diffPR = diffPR;
+    opt.maxIterations = maxIterations;
+    if (opt.stableTop > 0) {
+        opt.lexRank = ListLexRanks(allUrls);
+    }
+
+    PR pr = newPageRank(numUrls, opt.extrapolation == EXTRAPOLATE_NONE ?
+                                 RANK_HISTORY : EXTRAPOLATION_HISTORY);
+    struct rankStats run;
+    weightPageRank(&opt, directUrl, pr, pool, &run);
+
+    // publish the last iteration
+    if (run.iterations > 0) {
+        ListSetWeightedPR(allUrls, pageRankHistory(pr, 0));
+    }
+
+    // --compare runs plain Jacobi iteration as well, to measure against
+    if (stats || compare) {
+        showStats(&opt, &run);
+    }
+    if (compare) {
+        compareWithJacobi(&opt, &run, directUrl, pr, pool);
+    }
 
     List sorted = sortList(allUrls);
     listShow(sorted);
 
+    // the ranks are also kept at full precision for searchPageRank
+    bool ok = binaryPath == NULL || ListWriteRankTable(sorted, binaryPath);
+    if (!ok) {
+        fprintf(stderr, "Can't write %s\n", binaryPath);
+    }
+
     PageRankFree(pr);
+    PoolFree(pool);
+    if (archive != NULL) {
+        ArchiveFree(archive);
+    }
     GraphFree(directUrl);
     ListFree(allUrls); 
     ListFree(sorted);
 
-    return 0;
+    return ok ? 0 : EXIT_FAILURE;
+}
+
+/*
+ * Position of arg in names, or -1 if it isn't there
+ */
+int nameIndex(const char *arg, const char *const *names, int n) {
+    for (int i = 0; i < n; i++) {
+        if (strcmp(arg, names[i]) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
 }
 
 /*
- * Make a 2D array for recording every page rank value for each iteration
- * for each url. Every url's 0th iteration is setted as 1/number of iterations
+ * Make a ring of `history` rank vectors (at least 2) for the urls. 
+ * Every url's 0th iteration is setted as 1/number of urls
  */
-PR newPageRank(int urls, int iterations) {
+PR newPageRank(int urls, int history) {
     assert(urls != 0);
-    assert(iterations != 0);
 
     PR pr = malloc(sizeof(*pr));
     if (pr == NULL) {
@@ -84,25 +483,27 @@ PR newPageRank(int urls, int iterations) {
         exit(EXIT_FAILURE);
     }
 
-    pr->numUrl = urls;
-    pr->numIter = iterations;
+    int perLine = RANK_ALIGNMENT / sizeof(double);
 
-    pr->weight = malloc(urls * sizeof(double *));
-    if (pr->weight == NULL) {
+    pr->numUrl = urls;
+    pr->stride = (urls + perLine - 1) / perLine * perLine;
+    pr->numKept = history < 2 ? 2 : history;
+    pr->newest = 0;
+    pr->numIter = 0;
+
+    size_t bytes = (size_t) pr->stride * pr->numKept * sizeof(double);
+    pr->ranks = aligned_alloc(RANK_ALIGNMENT, bytes);
+    if (pr->ranks == NULL) {
         fprintf(stderr, "error: out of memory\n");
         exit(EXIT_FAILURE);
     }
 
+    memset(pr->ranks, 0, bytes);
+
     double firstIterValue = 1.0 / (double) urls;
 
     for (int i = 0; i < urls; i++) {
-        pr->weight[i] = calloc(iterations, sizeof(double));
-        if (pr->weight[i] == NULL) {
-            fprintf(stderr, "error: out of memory\n");
-            exit(EXIT_FAILURE);
-        }
-
-        pr->weight[i][0] = firstIterValue;
+        pr->ranks[i] = firstIterValue;
     }
 
     return pr;
@@ -112,12 +513,31 @@ PR newPageRank(int urls, int iterations) {
  * Free whole page rank struct.
  */
 void PageRankFree(PR pr) {
-    for (int i = 0; i < pr->numUrl; i++) {
-        free(pr->weight[i]);
+    free(pr->ranks);
+    free(pr);
+}
+
+/*
+ * Start a new iteration: the oldest vector in the ring becomes the 
+ * current one, to be overwritten, and the old current one the previous
+ */
+void pageRankAdvance(PR pr) {
+    pr->newest = (pr->newest + 1) % pr->numKept;
+    pr->numIter++;
+}
+
+/*
+ * Return the rank vector of `age` iterations ago (0 is the current one).
+ * Only the last numKept vectors are kept, and nothing older than the
+ * initial vector exists, so anything beyond that returns NULL
+ */
+double *pageRankHistory(PR pr, int age) {
+    if (age < 0 || age >= pr->numKept || age > pr->numIter) {
+        return NULL;
     }
 
-    free(pr->weight);
-    free(pr);
+    int slot = (pr->newest - age + pr->numKept) % pr->numKept;
+    return pr->ranks + (size_t) slot * pr->stride;
 }
 
 /*
@@ -128,70 +548,390 @@ static double probability(double d, int N) {
 }
 
 /*
- * It counts the number of inlinks from the given url
+ * It counts the number of inlinks from the given url, ignoring a self link
  */
 static int numOfInLinks(Graph directUrl, int currUrl) {
-    int numInL = 0;
-    for (int parent = 0; parent < GraphNumVertices(directUrl); parent++) {
-        if (edgeValue(directUrl, parent, currUrl) && parent != currUrl) {
-            numInL++;
+    return GraphInDegree(directUrl, currUrl) 
+           - GraphIsAdjacent(directUrl, currUrl, currUrl);
+}
+
+/*
+ * Number of outlinks used by the outlink weight: a page without outlinks
+ * counts as 0.5 so that it still receives a share
+ */
+static double outLinksCount(Graph directUrl, int url) {
+    int numOutL = numOfOutLinks(directUrl, url);
+
+    return numOutL == 0 ? 0.5 : (double) numOutL;
+}
+
+/*
+ * Precompute W_in(j, i) * W_out(j, i) for every link(j, i). Both weights
+ * only depend on the graph, so this is done once before iterating.
+ * The result is stored per in-edge slot (see GraphInOffset), and a self
+ * link gets a weight of 0. Runs in O(V + E).
+ */
+static double *linkWeights(Graph directUrl) {
+    int numUrls = GraphNumVertices(directUrl);
+    int numEdges = GraphNumEdges(directUrl);
+    int v, i, numL;
+
+    double *weights = malloc((numEdges > 0 ? numEdges : 1) * sizeof(double));
+    double *inSum = calloc(numUrls, sizeof(double));
+    double *outSum = calloc(numUrls, sizeof(double));
+    if (weights == NULL || inSum == NULL || outSum == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // denominators: sums over the pages each url j links to
+    for (v = 0; v < numUrls; v++) {
+        const urlNum *outLinks = GraphOutLinks(directUrl, v, &numL);
+        for (i = 0; i < numL; i++) {
+            inSum[v] += numOfInLinks(directUrl, outLinks[i]);
+            outSum[v] += outLinksCount(directUrl, outLinks[i]);
         }
     }
 
-    return numInL;
+    for (v = 0; v < numUrls; v++) {
+        double inL = (double) numOfInLinks(directUrl, v);
+        double outL = outLinksCount(directUrl, v);
+        const urlNum *linkJs = GraphInLinks(directUrl, v, &numL);
+        double *edge = weights + GraphInOffset(directUrl, v);
+
+        for (i = 0; i < numL; i++) {
+            if (linkJs[i] == v) {
+                edge[i] = 0.0;
+                continue;
+            }
+
+            edge[i] = (inL / inSum[linkJs[i]]) * (outL / outSum[linkJs[i]]);
+        }
+    }
+
+    free(inSum);
+    free(outSum);
+
+    return weights;
+}
+
+/*
+ * The in-links and weights of the graph in the layout the kernels read.
+ * The page rank of a url is a weighted sum over its parent links taken 
+ * straight from the graph's in-adjacency
+ */
+static RankInput rankInput(double d, Graph directUrl, 
+                           const double *weights) {
+    RankInput input;
+    input.offset = GraphInOffsets(directUrl);
+    input.sources = GraphInSources(directUrl);
+    input.weights = weights;
+    input.prob = probability(d, GraphNumVertices(directUrl));
+    input.d = d;
+
+    return input;
+}
+
+/*
+ * Amount of work before url: one per url plus one per in-link
+ */
+static long workBefore(Graph directUrl, int numUrls, int url) {
+    if (url == numUrls) {
+        return (long) numUrls + GraphNumEdges(directUrl);
+    }
+
+    return (long) url + GraphInOffset(directUrl, url);
 }
 
 /*
- * It calculates the inlink weight of link(j, i) 
+ * Cut the urls into chunks of about CHUNK_WORK work, then give every 
+ * worker a run of consecutive chunks holding about the same amount of 
+ * work, so a few pages with many in-links don't stall one thread
  */
-static double inLinksWeight(Graph directUrl, int urlJ, int urlI) {
-    double numerator = (double) numOfInLinks(directUrl, urlI);
-    double denominator = 0;
+static struct rankSweep *newSweep(const struct rankOptions *opt, 
+                                  int numUrls, Graph directUrl,
+                                  const double *weights, int numWorkers) {
+    struct rankSweep *s = malloc(sizeof(*s));
+    int *chunkStart = malloc((numUrls + 1) * sizeof(int));
+    int *workerChunk = malloc((numWorkers + 1) * sizeof(int));
+    if (s == NULL || chunkStart == NULL || workerChunk == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
 
-    int outLink;
-    for (outLink = 0; outLink < GraphNumVertices(directUrl); outLink++) {
-        if (edgeValue(directUrl, urlJ, outLink)) {
-            denominator += numOfInLinks(directUrl, outLink);
+    int c = 0;
+    for (int url = 0; url < numUrls; url++) {
+        if (
+            c == 0 ||
+            workBefore(directUrl, numUrls, url) 
+            - workBefore(directUrl, numUrls, chunkStart[c - 1]) >= CHUNK_WORK
+        ) {
+            chunkStart[c++] = url;
         }
     }
+    chunkStart[c] = numUrls;
+
+    long total = workBefore(directUrl, numUrls, numUrls);
+    int chunk = 0;
+    for (int w = 0; w < numWorkers; w++) {
+        long from = total * w / numWorkers;
+        while (
+            chunk < c && 
+            workBefore(directUrl, numUrls, chunkStart[chunk]) < from
+        ) {
+            chunk++;
+        }
+        workerChunk[w] = chunk;
+    }
+    workerChunk[numWorkers] = c;
+
+    s->input = rankInput(opt->d, directUrl, weights);
+    s->kernel = opt->kernel;
+    s->prev = NULL;
+    s->curr = NULL;
+    s->numChunks = c;
+    s->chunkStart = chunkStart;
+    s->workerChunk = workerChunk;
+    s->chunkDiff = calloc(c > 0 ? c : 1, sizeof(double));
+    if (s->chunkDiff == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
 
-    return numerator / denominator;
+    return s;
+}
+
+static void freeSweep(struct rankSweep *s) {
+    free(s->chunkStart);
+    free(s->workerChunk);
+    free(s->chunkDiff);
+    free(s);
 }
 
 /*
- * It calculates the outlink weight of link(j, i)
+ * A worker's share of one iteration: the new page rank of every url in
+ * its chunks, and the difference to the previous iteration in the same
+ * pass
  */
-static double outLinksWeight(Graph directUrl, int urlJ, int urlI) {
-    double numerator = numOfOutLinks(directUrl, urlI);
-    double denominator = 0.0;
-    int outLink, totalOutL;
+static void sweepChunks(void *arg, int worker) {
+    struct rankSweep *s = arg;
 
-    if (numerator == 0.0) {
-        numerator = 0.5;
+    for (int c = s->workerChunk[worker]; c < s->workerChunk[worker + 1]; c++) {
+        s->chunkDiff[c] = s->kernel.sweep(&s->input, s->prev, s->curr, 
+                                          s->chunkStart[c], 
+                                          s->chunkStart[c + 1]);
     }
+}
 
-    for (outLink = 0; outLink < GraphNumVertices(directUrl); outLink++) {
-        if (edgeValue(directUrl, urlJ, outLink)) {
-            totalOutL = numOfOutLinks(directUrl, outLink);
-            if (totalOutL == 0) {
-                denominator += 0.5;
-            } else {
-                denominator += (double) totalOutL;
+/*
+ * Urls by number of out-links, most first, so that a Gauss-Seidel sweep
+ * passes the fresh ranks of the pages that feed the most others on 
+ * within the same sweep. Equal ones keep collection order
+ */
+static int *degreeOrder(Graph directUrl) {
+    int numUrls = GraphNumVertices(directUrl);
+    int *order = malloc((numUrls > 0 ? numUrls : 1) * sizeof(int));
+    int *count = calloc(numUrls + 2, sizeof(int));
+    if (order == NULL || count == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // counting sort on the out-degree, which is at most numUrls
+    for (int v = 0; v < numUrls; v++) {
+        count[numUrls - numOfOutLinks(directUrl, v) + 1]++;
+    }
+    for (int k = 1; k <= numUrls + 1; k++) {
+        count[k] += count[k - 1];
+    }
+    for (int v = 0; v < numUrls; v++) {
+        order[count[numUrls - numOfOutLinks(directUrl, v)]++] = v;
+    }
+
+    free(count);
+    return order;
+}
+
+/*
+ * Urls in reverse postorder of a depth-first search along the out-links,
+ * which puts every page before the pages it links to whenever the links
+ * have no cycle, and close to that when they do
+ */
+static int *topoOrder(Graph directUrl) {
+    int numUrls = GraphNumVertices(directUrl);
+    int size = numUrls > 0 ? numUrls : 1;
+    int *order = malloc(size * sizeof(int));
+    int *stack = malloc(size * sizeof(int));
+    int *nextLink = malloc(size * sizeof(int));
+    bool *seen = calloc(size, sizeof(bool));
+    if (order == NULL || stack == NULL || nextLink == NULL || seen == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int done = numUrls;
+    for (int root = 0; root < numUrls; root++) {
+        if (seen[root]) {
+            continue;
+        }
+
+        int top = 0;
+        stack[top++] = root;
+        nextLink[root] = 0;
+        seen[root] = true;
+        while (top > 0) {
+            int v = stack[top - 1];
+            int numL;
+            const urlNum *links = GraphOutLinks(directUrl, v, &numL);
+            if (nextLink[v] == numL) {
+                order[--done] = v;
+                top--;
+                continue;
             }
 
+            int w = links[nextLink[v]++];
+            if (!seen[w]) {
+                seen[w] = true;
+                nextLink[w] = 0;
+                stack[top++] = w;
+            }
         }
     }
 
-    return numerator / denominator;
+    free(stack);
+    free(nextLink);
+    free(seen);
+    return order;
+}
+
+/*
+ * The order of the urls in a Gauss-Seidel sweep
+ */
+static int *sweepOrder(Graph directUrl, enum rankOrder order) {
+    if (order == ORDER_DEGREE) {
+        return degreeOrder(directUrl);
+    } else if (order == ORDER_TOPO) {
+        return topoOrder(directUrl);
+    }
+
+    int numUrls = GraphNumVertices(directUrl);
+    int *natural = malloc((numUrls > 0 ? numUrls : 1) * sizeof(int));
+    if (natural == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int v = 0; v < numUrls; v++) {
+        natural[v] = v;
+    }
+
+    return natural;
+}
+
+/*
+ * One iteration from the ranks in `from` into `to`, returning its diff
+ */
+static double iterate(struct rankSweep *sweep, const int *order, 
+                      ThreadPool pool, int numUrls, const double *from, 
+                      double *to) {
+    if (order != NULL) {
+        memcpy(to, from, numUrls * sizeof(double));
+        return RankSweepInPlace(&sweep->input, to, order, numUrls);
+    }
+
+    sweep->prev = from;
+    sweep->curr = to;
+    PoolRun(pool, sweepChunks, sweep);
+
+    double diff = 0.0;
+    for (int c = 0; c < sweep->numChunks; c++) {
+        diff += sweep->chunkDiff[c];
+    }
+
+    return diff;
+}
+
+/*
+ * Aitken's delta-squared on every url from its last three ranks. A url
+ * whose correction would be larger than its rank isn't converging 
+ * geometrically, and keeps its latest rank
+ */
+static void aitken(const double *x0, const double *x1, const double *x2, 
+                   int numUrls, double *out) {
+    for (int i = 0; i < numUrls; i++) {
+        double step = x2[i] - x1[i];
+        double curve = x2[i] - 2 * x1[i] + x0[i];
+        double correction = curve != 0.0 ? step * step / curve : 0.0;
+
+        out[i] = fabs(correction) < fabs(x2[i]) ? x2[i] - correction : x2[i];
+    }
+}
+
+/*
+ * Quadratic extrapolation from the last four ranks. An iteration is 
+ * x' = p + d * W x, so once all but two directions of the error have 
+ * died out there are c0, c1 with c0 e1 + c1 e2 + e3 = 0 for the errors
+ * of x1, x2, x3. They are fitted by least squares on the differences of
+ * the iterations, which share the same relation, and the limit is then
+ * (c0 x1 + c1 x2 + x3) / (c0 + c1 + 1). Dividing by the sum takes the 
+ * place of renormalising, since weighted ranks don't keep a fixed total.
+ * Returns false when the fit breaks down
+ */
+static bool quadratic(const double *x0, const double *x1, const double *x2,
+                      const double *x3, int numUrls, double *out) {
+    double a11 = 0.0, a12 = 0.0, a22 = 0.0, b1 = 0.0, b2 = 0.0;
+    for (int i = 0; i < numUrls; i++) {
+        double u0 = x1[i] - x0[i];
+        double u1 = x2[i] - x1[i];
+        double u2 = x3[i] - x2[i];
+        a11 += u0 * u0;
+        a12 += u0 * u1;
+        a22 += u1 * u1;
+        b1 -= u0 * u2;
+        b2 -= u1 * u2;
+    }
+
+    double det = a11 * a22 - a12 * a12;
+    if (!(fabs(det) > DBL_EPSILON * a11 * a22)) {
+        return false;
+    }
+
+    double c0 = (b1 * a22 - b2 * a12) / det;
+    double c1 = (a11 * b2 - a12 * b1) / det;
+    double sum = c0 + c1 + 1.0;
+    if (!(fabs(sum) > DBL_EPSILON)) {
+        return false;
+    }
+
+    for (int i = 0; i < numUrls; i++) {
+        out[i] = (c0 * x1[i] + c1 * x2[i] + x3[i]) / sum;
+    }
+
+    return true;
 }
-  
+
 /*
- * Given url is already a parent link or not. If no then return true,
- * otherwise return false.
+ * Extrapolate the ranks in the ring into out. Returns false if there 
+ * aren't enough iterations in the ring or the extrapolation broke down
  */
-static bool isNew(int parentLinks[], int size, int preparedParentL) {
-    for (int i = 0; i < size; i++) {
-        if (parentLinks[i] == preparedParentL) {
+static bool extrapolate(PR pr, enum rankExtrapolation method, double *out) {
+    int needed = method == EXTRAPOLATE_AITKEN ? 3 : 4;
+    double *x[EXTRAPOLATION_HISTORY];
+    for (int age = 0; age < needed; age++) {
+        x[age] = pageRankHistory(pr, age);
+        if (x[age] == NULL) {
+            return false;
+        }
+    }
+
+    if (method == EXTRAPOLATE_AITKEN) {
+        aitken(x[2], x[1], x[0], pr->numUrl, out);
+    } else if (!quadratic(x[3], x[2], x[1], x[0], pr->numUrl, out)) {
+        return false;
+    }
+
+    for (int i = 0; i < pr->numUrl; i++) {
+        if (!isfinite(out[i])) {
             return false;
         }
     }
@@ -200,186 +940,820 @@ static bool isNew(int parentLinks[], int size, int preparedParentL) {
 }
 
 /*
- * Calculate the number of valid links (value != -1) inside the given array
+ * The state of an adaptive run, or NULL when every iteration recomputes
+ * every url. A url may move by diffPR / numUrls and still be frozen, so
+ * the frozen ones together stay within one diffPR of their true ranks
  */
-static int numParentL(int parentLinks[], int size) {
-    int num = 0;
-    for (int i = 0; i < size; i++) {
-        if (parentLinks[i] != -1) {
-            num++;
-        }
+static struct adaptive *newAdaptive(const struct rankOptions *opt, 
+                                    int numUrls) {
+    if (opt->freezeAfter <= 0) {
+        return NULL;
+    }
+
+    struct adaptive *a = malloc(sizeof(*a));
+    int size = numUrls > 0 ? numUrls : 1;
+    if (a != NULL) {
+        a->calm = calloc(size, sizeof(int));
+        a->woken = malloc(size * sizeof(int));
+        a->urls = malloc(size * sizeof(int));
+    }
+    if (a == NULL || a->calm == NULL || a->woken == NULL || a->urls == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    a->freezeAfter = opt->freezeAfter;
+    a->fullSweep = opt->fullSweep;
+    a->tolerance = opt->diffPR / (numUrls > 0 ? numUrls : 1);
+    for (int url = 0; url < numUrls; url++) {
+        a->woken[url] = -1;
+    }
+    a->full = false;
+    a->updates = 0;
+
+    return a;
+}
+
+/*
+ * The top pages to watch, or NULL without --stable-top
+ */
+static struct topWatch *newTopWatch(const struct rankOptions *opt, 
+                                    int numUrls) {
+    if (opt->stableTop <= 0) {
+        return NULL;
+    }
+
+    struct topWatch *w = malloc(sizeof(*w));
+    int size = numUrls > 0 ? numUrls : 1;
+    if (w != NULL) {
+        w->k = opt->stableTop < numUrls ? opt->stableTop : numUrls;
+        w->kept = w->k < numUrls ? w->k + 1 : numUrls;
+        w->keys = malloc(size * sizeof(RankKey));
+        w->best = malloc(size * sizeof(RankKey));
+        w->last = malloc(size * sizeof(int));
+    }
+    if (w == NULL || w->keys == NULL || w->best == NULL || w->last == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int url = 0; url < numUrls; url++) {
+        w->keys[url].matches = 0;
+        w->keys[url].lexRank = opt->lexRank[url];
+        w->keys[url].page = url;
+    }
+    for (int i = 0; i < w->kept; i++) {
+        w->last[i] = -1;
+    }
+    w->stable = 0;
+
+    return w;
+}
+
+static void freeTopWatch(struct topWatch *w) {
+    if (w == NULL) {
+        return;
+    }
+
+    free(w->keys);
+    free(w->best);
+    free(w->last);
+    free(w);
+}
+
+/*
+ * Select this iteration's top pages, in the order pageRankList will 
+ * have them, with a bounded heap rather than a sort of every url, and 
+ * count how long they have been stable
+ */
+static void watchTop(struct topWatch *w, int numUrls, const double *prev,
+                     const double *curr) {
+    for (int url = 0; url < numUrls; url++) {
+        w->keys[url].weightedPR = curr[url];
+    }
+    SortTopK(w->keys, numUrls, w->kept, w->best);
+
+    bool same = true;
+    for (int i = 0; i < w->kept; i++) {
+        same = same && w->best[i].page == w->last[i];
+        w->last[i] = w->best[i].page;
+    }
+
+    if (same && w->kept > w->k) {
+        int kth = w->best[w->k - 1].page;
+        int next = w->best[w->k].page;
+        double gap = curr[kth] - curr[next];
+        double moved = fabs(curr[kth] - prev[kth]) + 
+                       fabs(curr[next] - prev[next]);
+        same = gap > moved;
     }
 
-    return num;
+    w->stable = same ? w->stable + 1 : 0;
 }
 
 /*
- * Get array of links to the current Url. 
- * During the process, we remove those self links and those parallel edges
+ * Estimate how many more iterations it takes for the diff to drop below 
+ * diffPR, if it keeps shrinking by the same factor as in the last one.
+ * Only --compare measures it
  */
-static int *parentLinks(Graph directUrl, int currIter) {
-    int i;
-    int numLinks = GraphNumVertices(directUrl); 
-    int *links = malloc(sizeof(int) * numLinks);
+static int iterationsLeft(double lastDiff, double diff, double diffPR,
+                          int most) {
+    if (diff < diffPR) {
+        return 0;
+    }
+
+    double factor = diff / lastDiff;
+    if (!(factor > 0.0 && factor < 1.0)) {
+        return most;
+    }
 
-    for (i = 0; i < numLinks; i++) {
-        links[i] = -1;
+    double left = ceil(log(diffPR / diff) / log(factor));
+    return left < most ? (int) left : most;
+}
+
+static void freeAdaptive(struct adaptive *a) {
+    if (a == NULL) {
+        return;
+    }
+
+    free(a->calm);
+    free(a->woken);
+    free(a->urls);
+    free(a);
+}
+
+/*
+ * One iteration of an adaptive run, from the ranks in from to the ranks
+ * in to: frozen urls keep their rank and only the others are computed, 
+ * in sweep order. A full sweep is made every fullSweep iterations, and 
+ * whenever the last diff was small enough to stop, so a run only stops 
+ * after a full sweep has confirmed it. Single threaded
+ */
+static double iterateAdaptive(struct adaptive *a, struct rankSweep *sweep,
+                              const int *order, Graph directUrl, int iter, 
+                              double lastDiff, double diffPR, 
+                              const double *from, double *to) {
+    int numUrls = GraphNumVertices(directUrl);
+    bool full = lastDiff < diffPR || 
+                (a->fullSweep > 0 && iter % a->fullSweep == 0);
+
+    int n = 0;
+    for (int i = 0; i < numUrls; i++) {
+        int url = order != NULL ? order[i] : i;
+        if (full || a->calm[url] < a->freezeAfter || a->woken[url] == iter) {
+            a->urls[n++] = url;
+        }
     }
 
-    int numParent = 0;
-    for (i = 0; i < numLinks; i++) {
-        // avoid self links
-        if (i == currIter) {
+    memcpy(to, from, numUrls * sizeof(double));
+    double diff = order != NULL ? 
+                  RankSweepInPlace(&sweep->input, to, a->urls, n) :
+                  RankSweepSelected(&sweep->input, from, to, a->urls, n);
+
+    // a url that still moves wakes up the urls it links to
+    for (int i = 0; i < n; i++) {
+        int url = a->urls[i];
+        if (fabs(to[url] - from[url]) < a->tolerance) {
+            if (a->calm[url] < a->freezeAfter) {
+                a->calm[url]++;
+            }
             continue;
         }
 
-        if (
-            edgeValue(directUrl, i, currIter)
-            && isNew(links, numLinks, i)
-        ) {
-            links[numParent++] = i;
+        a->calm[url] = 0;
+        int numLinks;
+        const urlNum *links = GraphOutLinks(directUrl, url, &numLinks);
+        for (int k = 0; k < numLinks; k++) {
+            a->woken[links[k]] = iter + 1;
         }
     }
 
-    return links;
+    a->full = full;
+    a->updates += n;
+
+    return diff;
 }
 
 /*
- * Calculate the pageRank for a iteration with two given urls
+ * Calculate the weighted page rank with the given values and algorithm.
+ * A Jacobi iteration computes every url from the previous iteration, 
+ * split over the workers of the pool. A Gauss-Seidel iteration starts 
+ * from the previous iteration and updates it in place, url by url in
+ * the chosen order, on this thread alone. An adaptive run freezes the
+ * urls that have stopped moving, see iterateAdaptive
  */
-static double calculatePageRank(double d, int N, PR pr, int urlI, int currIter,
-                                Graph directUrl, int prevIter) {
-    int i;
-    double product;
-    double sum = 0.0;
-    double prob = probability(d, N);
-    int *linkJs = parentLinks(directUrl, urlI);
-    int sizeJs = numParentL(linkJs, GraphNumVertices(directUrl));
+void weightPageRank(const struct rankOptions *opt, Graph directUrl, PR pr,
+                    ThreadPool pool, struct rankStats *stats) {
+    double started = now();
+    int numUrls = GraphNumVertices(directUrl);
+    double diff = opt->diffPR;
+    int iter;
+    double *weights = linkWeights(directUrl);
+    struct rankSweep *sweep = newSweep(opt, numUrls, directUrl, weights, 
+                                       PoolSize(pool));
+    int *order = NULL;
+    if (opt->schedule == SCHEDULE_GAUSS_SEIDEL) {
+        order = sweepOrder(directUrl, opt->order);
+    }
+    struct adaptive *adaptive = newAdaptive(opt, numUrls);
+    struct topWatch *watch = newTopWatch(opt, numUrls);
+    double lastDiff = diff;
+
+    // the extrapolated ranks and the iteration from them
+    double *jump = NULL;
+    double *jumpNext = NULL;
+    if (opt->extrapolation != EXTRAPOLATE_NONE) {
+        jump = malloc((numUrls + 1) * sizeof(double));
+        jumpNext = malloc((numUrls + 1) * sizeof(double));
+        if (jump == NULL || jumpNext == NULL) {
+            fprintf(stderr, "error: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    stats->extrapolations = 0;
+    stats->kept = 0;
+    int sinceJump = 0;
 
-    for (i = 0; i < sizeJs; i++) {
-        product = 1.0;
+    for (
+        iter = 0; 
+        iter < opt->maxIterations - 1 && 
+        (diff >= opt->diffPR || (adaptive != NULL && !adaptive->full)) &&
+        (watch == NULL || watch->stable < opt->stableFor);
+        iter++
+    ) {
+        // extrapolate before the oldest vector in the ring is reused
+        bool jumped = jump != NULL && sinceJump >= EXTRAPOLATION_PERIOD &&
+                      extrapolate(pr, opt->extrapolation, jump);
+
+        pageRankAdvance(pr);
+        double *prev = pageRankHistory(pr, 1);
+        double *curr = pageRankHistory(pr, 0);
+        lastDiff = diff;
+        if (adaptive != NULL) {
+            diff = iterateAdaptive(adaptive, sweep, order, directUrl, iter, 
+                                   diff, opt->diffPR, prev, curr);
+        } else {
+            diff = iterate(sweep, order, pool, numUrls, prev, curr);
+            sinceJump++;
+        }
 
-        product *= pr->weight[linkJs[i]][prevIter];
-        product *= inLinksWeight(directUrl, linkJs[i], urlI);
-        product *= outLinksWeight(directUrl, linkJs[i], urlI);
+        // the jump is only kept if iterating from it moves the ranks less
+        // than iterating from where they were, so it never slows down
+        if (jumped) {
+            double jumpDiff = iterate(sweep, order, pool, numUrls, jump, 
+                                      jumpNext);
+            stats->extrapolations++;
+            sinceJump = 0;
+            if (jumpDiff < diff) {
+                memcpy(prev, jump, numUrls * sizeof(double));
+                memcpy(curr, jumpNext, numUrls * sizeof(double));
+                diff = jumpDiff;
+                stats->kept++;
+                sinceJump = 1;
+            }
+        }
 
-        sum += product;
+        if (watch != NULL) {
+            watchTop(watch, numUrls, prev, curr);
+        }
     }
 
-    free(linkJs);
+    stats->iterations = iter;
+    stats->sweeps = iter + stats->extrapolations;
+    stats->seconds = now() - started;
+    stats->diff = diff;
+    stats->updates = adaptive != NULL ? adaptive->updates : 
+                                        (long) stats->sweeps * numUrls;
+    stats->numUrls = numUrls;
+    stats->stable = watch != NULL && watch->stable >= opt->stableFor;
+    stats->saved = stats->stable ? 
+                   iterationsLeft(lastDiff, diff, opt->diffPR, 
+                                  opt->maxIterations - 1 - iter) : 0;
+
+    freeTopWatch(watch);
+    freeAdaptive(adaptive);
+    free(jump);
+    free(jumpNext);
+    free(order);
+    freeSweep(sweep);
+    free(weights);
+}
 
-    return (prob + d * sum);
+/*
+ * Print how a run went to stderr
+ */
+void showStats(const struct rankOptions *opt, const struct rankStats *run) {
+    fprintf(stderr, "%s", scheduleNames[opt->schedule]);
+    if (opt->schedule == SCHEDULE_GAUSS_SEIDEL) {
+        fprintf(stderr, " (%s order)", orderNames[opt->order]);
+    }
+    if (opt->extrapolation != EXTRAPOLATE_NONE) {
+        fprintf(stderr, " with %s extrapolation", 
+                extrapolationNames[opt->extrapolation]);
+    }
+    if (opt->freezeAfter > 0) {
+        fprintf(stderr, ", adaptive (frozen after %d)", opt->freezeAfter);
+    }
+
+    fprintf(stderr, ": %d iterations, %.3f ms, last diff %.3g", 
+            run->iterations, run->seconds * 1e3, run->diff);
+    if (opt->extrapolation != EXTRAPOLATE_NONE) {
+        fprintf(stderr, ", %d sweeps, %d of %d extrapolations kept", 
+                run->sweeps, run->kept, run->extrapolations);
+    }
+    if (opt->freezeAfter > 0) {
+        long all = (long) run->iterations * run->numUrls;
+        fprintf(stderr, ", %ld url updates (%.1f%% of %ld)", run->updates,
+                all > 0 ? 100.0 * run->updates / all : 0.0, all);
+    }
+    if (run->stable) {
+        fprintf(stderr, ", top %d stable for %d iterations, an estimated "
+                "%d iterations short of diffPR", opt->stableTop, 
+                opt->stableFor, run->saved);
+    }
+    fprintf(stderr, "\n");
 }
 
 /*
- * Calculate the sum of differences between the given url's last iteration 
- * page rank and previous iteration and current iteration
+ * Run plain Jacobi iteration with the same settings and report it next 
+ * to the run that produced pr, with how far apart their ranks ended up
  */
-static double calculateDiff(PR pr, int prevIter, int currIter, 
-                            int urlI) {
-    double diff = 0.0;
-    int url;
+void compareWithJacobi(const struct rankOptions *opt, 
+                       const struct rankStats *run, Graph directUrl, 
+                       PR pr, ThreadPool pool) {
+    struct rankOptions jacobi = *opt;
+    jacobi.schedule = SCHEDULE_JACOBI;
+    jacobi.order = ORDER_NATURAL;
+    jacobi.extrapolation = EXTRAPOLATE_NONE;
+    jacobi.freezeAfter = 0;
+    jacobi.stableTop = 0;
+
+    int numUrls = GraphNumVertices(directUrl);
+    PR base = newPageRank(numUrls, RANK_HISTORY);
+    struct rankStats baseRun;
+    weightPageRank(&jacobi, directUrl, base, pool, &baseRun);
+    showStats(&jacobi, &baseRun);
+
+    // what stopping on the top pages saved, measured rather than estimated
+    if (run->stable) {
+        fprintf(stderr, "stopped %d iterations before jacobi reached "
+                "diffPR (estimated %d)\n", 
+                baseRun.iterations - run->iterations, run->saved);
+    }
 
-    for (url = 0; url < pr->numUrl; url++) {
-        diff += fabs(pr->weight[url][currIter] - pr->weight[url][prevIter]);
+    const double *ranks = pageRankHistory(pr, 0);
+    const double *baseRanks = pageRankHistory(base, 0);
+    double total = 0.0;
+    double largest = 0.0;
+    for (int i = 0; i < numUrls; i++) {
+        double gap = fabs(ranks[i] - baseRanks[i]);
+        total += gap;
+        largest = gap > largest ? gap : largest;
     }
 
-    return diff;
+    fprintf(stderr, "ranks differ by %.3g in total, %.3g at most "
+            "(diffPR %g)\n", total, largest, opt->diffPR);
+
+    // and for --stable-top, whether the top pages came out the same
+    struct topWatch *top = newTopWatch(opt, numUrls);
+    struct topWatch *baseTop = newTopWatch(opt, numUrls);
+    if (top != NULL) {
+        watchTop(top, numUrls, ranks, ranks);
+        watchTop(baseTop, numUrls, baseRanks, baseRanks);
+
+        int same = 0;
+        while (
+            same < top->k && 
+            top->best[same].page == baseTop->best[same].page
+        ) {
+            same++;
+        }
+        if (same == top->k) {
+            fprintf(stderr, "top %d order matches\n", top->k);
+        } else {
+            fprintf(stderr, "top %d order differs from position %d\n", 
+                    top->k, same + 1);
+        }
+    }
+    freeTopWatch(top);
+    freeTopWatch(baseTop);
+
+    PageRankFree(base);
+}
+
+static void *checkAlloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return p;
+}
+
+static void pairAppend(struct pairBuffer *b, int x, int y) {
+    if (b->size + 2 > b->cap) {
+        b->cap = b->cap == 0 ? 64 : b->cap * 2;
+        b->pairs = checkAlloc(realloc(b->pairs, b->cap * sizeof(int)));
+    }
+
+    b->pairs[b->size++] = x;
+    b->pairs[b->size++] = y;
 }
 
 /*
- * Calculate the weighted page rank with the given values and algorithm
+ * Read the pages of every chunk given to this worker
  */
-void weightPageRank(double d, double diffPR, int maxIterations, 
-                    int numUrls, Graph directUrl, List allUrls, PR pr) {
-    double diff = diffPR;
-    int iter, prevIter, currIter, urlI;
+static void ingestChunks(void *arg, int worker) {
+    struct ingest *in = arg;
+    size_t cap = MAX_URL_LENGTH;
+    char *urlFile = checkAlloc(malloc(sizeof(char) * cap));
+
+    struct ingestScratch scratch;
+    scratch.linked = checkAlloc(malloc(sizeof(int) * 
+                                       (in->numUrls > 0 ? in->numUrls : 1)));
+    for (int i = 0; i < in->numUrls; i++) {
+        scratch.linked[i] = -1;
+    }
+    scratch.word = NULL;
+    scratch.wordCap = 0;
 
-    for (iter = 0; iter < maxIterations - 1 && diff >= diffPR; iter++) {
-        prevIter = iter;
-        currIter = iter + 1;
+    for (int c = worker; c < in->numChunks; c += in->numWorkers) {
+        int last = (c + 1) * INGEST_CHUNK;
+        last = last > in->numUrls ? in->numUrls : last;
 
-        for (urlI = 0; urlI < numUrls; urlI++) {
-            pr->weight[urlI][currIter] = calculatePageRank(d, numUrls, pr, urlI, 
-                                                   currIter, directUrl, 
-                                                   prevIter);
+        if (in->withWords) {
+            in->chunks[c].terms = UrlTableNew();
+        }
+
+        for (int src = c * INGEST_CHUNK; src < last; src++) {
+            Reader r;
+            if (in->archive != NULL) {
+                Span page = ArchivePage(in->archive, src);
+                r = ReaderFromMemory(page.start, page.len);
+            } else {
+                const char *url = getUrlName(in->l, src);
+                size_t len = strlen(url) + strlen(txtFileExtent) + 1;
+                if (len > cap) {
+                    cap = len;
+                    urlFile = checkAlloc(realloc(urlFile, cap));
+                }
+
+                strcpy(urlFile, url);
+                strcat(urlFile, txtFileExtent);
+
+                r = ReaderOpen(urlFile);
+                if (r == NULL) {
+                    fprintf(stderr, "Can't open %s\n", urlFile);
+                    exit(EXIT_FAILURE);
+                }
+            }
+
+            doLinkUrl(&in->chunks[c], &scratch, src, r, in->l, 
+                      in->withWords);
+            ReaderClose(r);
+        }
+    }
+
+    free(urlFile);
+    free(scratch.linked);
+    free(scratch.word);
+}
+
+/*
+ * Add a chunk's words to the index. Pages come in order, so a page that
+ * uses a word twice is next to itself in the word's list
+ */
+static void mergeWords(struct wordIndex *words, struct pageChunk *chunk) {
+    int numLocal = UrlTableSize(chunk->terms);
+    int *global = checkAlloc(malloc(sizeof(int) * (numLocal + 1)));
+
+    for (int t = 0; t < numLocal; t++) {
+        int numTerms = UrlTableSize(words->terms);
+        global[t] = UrlTableIntern(words->terms, 
+                                   UrlTableName(chunk->terms, t),
+                                   UrlTableNameLength(chunk->terms, t));
+        if (global[t] == numTerms && (numTerms & (numTerms - 1)) == 0) {
+            int newCap = numTerms == 0 ? 1 : numTerms * 2;
+            words->pages = checkAlloc(realloc(words->pages, 
+                                      newCap * sizeof(struct pairBuffer)));
+            memset(words->pages + numTerms, 0, 
+                   (newCap - numTerms) * sizeof(struct pairBuffer));
+        }
+    }
 
-            updateWeightedPR(getUrlName(allUrls, urlI), allUrls,
-                                        pr->weight[urlI][currIter]);         
+    for (int w = 0; w < chunk->words.size; w += 2) {
+        int src = chunk->words.pairs[w];
+        int term = global[chunk->words.pairs[w + 1]];
+        struct pairBuffer *pages = &words->pages[term];
+        if (pages->size == 0 || pages->pairs[pages->size - 1] != src) {
+            if (pages->size == pages->cap) {
+                pages->cap = pages->cap == 0 ? 4 : pages->cap * 2;
+                pages->pairs = checkAlloc(realloc(pages->pairs, 
+                                          pages->cap * sizeof(int)));
+            }
+            pages->pairs[pages->size++] = src;
         }
+    }
+
+    free(global);
+}
 
-        diff = calculateDiff(pr, prevIter, currIter, urlI);
+/*
+ * The urls of the collection packed into the archive. Page i of the 
+ * archive is the page of the i-th url
+ */
+List archiveUrls(Archive archive) {
+    Span collection = ArchiveCollection(archive);
+    Reader r = ReaderFromMemory(collection.start, collection.len);
+    List allUrls = ListReadUrls(r);
+    ReaderClose(r);
+
+    if (ListLength(allUrls) != ArchiveNumPages(archive)) {
+        fprintf(stderr, "error: archive has %d pages for %d urls\n", 
+                ArchiveNumPages(archive), ListLength(allUrls));
+        exit(EXIT_FAILURE);
     }
+
+    return allUrls;
 }
 
 /*
- * Put the links between each pair of urls into a adjacency matrix
- * then return it
+ * Put the links between each pair of urls into a graph, then freeze
+ * it into its compact form and return it. The pages are read by all 
+ * the workers of the pool at once, from the archive if there is one. 
+ * If words isn't NULL, the words of every page's Section-2 are 
+ * collected into it in the same pass
  */
-Graph linkUrl(List allUrls) {
+Graph linkUrl(List allUrls, Archive archive, ThreadPool pool, 
+              struct wordIndex *words) {
     int numUrl = ListLength(allUrls);
     Graph directUrl = GraphNew(numUrl, numUrl);
-    char *urlFile = malloc(sizeof(char) * MAX_URL_LENGTH);
-    char *url = malloc(sizeof(char) * MAX_URL_LENGTH);
-    int i;
 
-    for (i = 0; i < numUrl; i++) {
-        strcpy(url, getUrlName(allUrls, i));
-        strcpy(urlFile, url);
-        strcat(urlFile, txtFileExtent);
+    struct ingest in;
+    in.l = allUrls;
+    in.archive = archive;
+    in.numUrls = numUrl;
+    in.withWords = words != NULL;
+    in.numChunks = (numUrl + INGEST_CHUNK - 1) / INGEST_CHUNK;
+    in.numWorkers = PoolSize(pool);
+    in.chunks = checkAlloc(calloc(in.numChunks > 0 ? in.numChunks : 1, 
+                                  sizeof(struct pageChunk)));
+
+    PoolRun(pool, ingestChunks, &in);
+
+    if (words != NULL) {
+        words->terms = UrlTableNew();
+        words->pages = NULL;
+    }
+
+    for (int c = 0; c < in.numChunks; c++) {
+        struct pageChunk *chunk = &in.chunks[c];
+        for (int e = 0; e < chunk->links.size; e += 2) {
+            GraphInsertEdge(directUrl, chunk->links.pairs[e], 
+                            chunk->links.pairs[e + 1]);
+        }
+
+        if (words != NULL) {
+            mergeWords(words, chunk);
+            UrlTableFree(chunk->terms);
+        }
 
-        directUrl = doLinkUrl(directUrl, url, urlFile, allUrls);
+        free(chunk->links.pairs);
+        free(chunk->words.pairs);
     }
 
-    free(url);
-    free(urlFile);
+    free(in.chunks);
+
+    GraphFreeze(directUrl);
 
     return directUrl;
 }
 
 /*
- * Process of put the relation between url links into the graph
+ * Lowercase the word and strip its trailing punctuation into buf, which
+ * is big enough for the whole word. Returns the new length
  */
-Graph doLinkUrl(Graph directUrl, char url[MAX_URL_LENGTH], 
-                char urlFile[MAX_URL_LENGTH], List l) {
-    FILE *fp = fopen(urlFile, "r");
-    if (fp == NULL) {
-		fprintf(stderr, "Can't open %s\n", urlFile);
-		exit(EXIT_FAILURE);
-	}
-    
-    char *nextUrl = malloc(sizeof(char) * MAX_URL_LENGTH);
-
-    while (fscanf(fp, "%s ", nextUrl) == 1) {
-        if (strcmp(end, nextUrl) == 0) {
+static int normaliseWord(Span word, char *buf) {
+    int len = word.len;
+    while (len > 0 && strchr(wordPunctuation, word.start[len - 1]) != NULL) {
+        len--;
+    }
+
+    for (int i = 0; i < len; i++) {
+        buf[i] = tolower((unsigned char) word.start[i]);
+    }
+
+    return len;
+}
+
+/*
+ * Process of put the relation between url links into the chunk, and the
+ * words of Section-2 as well if they are wanted
+ */
+void doLinkUrl(struct pageChunk *out, struct ingestScratch *scratch, 
+               int src, Reader r, List l, bool withWords) {
+    int *linked = scratch->linked;
+    Span nextUrl;
+    while (ReaderToken(r, &nextUrl)) {
+        if (SpanEquals(nextUrl, end)) {
             break;
-        } else if (!isLinkable(directUrl, url, nextUrl, l)) {
+        }
+
+        int dest = ListLookup(l, nextUrl.start, nextUrl.len);
+        if (!isLinkable(src, dest, nextUrl, l) || linked[dest] == src) {
             continue;
         } 
-      
-        GraphInsertEdge(directUrl, getUrlNum(l, url), getUrlNum(l, nextUrl));
+
+        linked[dest] = src;
+        pairAppend(&out->links, src, dest);
     }
 
-    fclose(fp);
-    free(nextUrl);
+    // the words are between "#start Section-2" and the next "#end"
+    Span word;
+    bool inWords = false;
+    while (withWords && ReaderToken(r, &word)) {
+        if (!inWords) {
+            Span next;
+            inWords = SpanEquals(word, start) && ReaderToken(r, &next) &&
+                      SpanEquals(next, wordSection);
+            continue;
+        } else if (SpanEquals(word, end)) {
+            break;
+        }
 
-    return directUrl;
-}
+        if (word.len > (size_t) scratch->wordCap) {
+            scratch->wordCap = word.len;
+            scratch->word = checkAlloc(realloc(scratch->word, 
+                                               scratch->wordCap));
+        }
 
+        int len = normaliseWord(word, scratch->word);
+        if (len > 0) {
+            pairAppend(&out->words, src, 
+                       UrlTableIntern(out->terms, scratch->word, len));
+        }
+    }
+}
 /*
  * Return true if the url can be linked, otherwise reutrn fasle
- * eliminate url string id not url snd self links
+ * eliminate url string id not url, urls outside the collection
+ * and self links
  */
-bool isLinkable(Graph directUrl, char srcUrl[MAX_URL_LENGTH], 
-                char destUrl[MAX_URL_LENGTH], List l) {
+bool isLinkable(int src, int dest, Span destUrl, List l) {
     if (
-        strcmp(start, destUrl) == 0 || 
-        strcmp(section, destUrl) == 0 ||
-        strcmp(srcUrl, destUrl) == 0 || 
-        GraphIsAdjacent(directUrl, getUrlNum(l, srcUrl), getUrlNum(l, destUrl))
+        SpanEquals(destUrl, start) || 
+        SpanEquals(destUrl, section) ||
+        dest == src || 
+        dest == ListLength(l)
     ) {
         return false;
     }
 
     return true;
-}
\ No newline at end of file
+}
+
+static int compareInt(const void *x, const void *y) {
+    return *(const int *) x - *(const int *) y;
+}
+
+/*
+ * Write the inverted index in the usual text form: one line per word, 
+ * words in alphabetical order, each followed by the urls of the pages it
+ * appears in, also in alphabetical order
+ */
+void writeWordIndex(struct wordIndex *words, List l, const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Can't open %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    int numTerms = UrlTableSize(words->terms);
+    int numUrls = ListLength(l);
+    int most = numTerms > numUrls ? numTerms : numUrls;
+    const char **names = checkAlloc(malloc(sizeof(char *) * (most + 1)));
+
+    for (int u = 0; u < numUrls; u++) {
+        names[u] = getUrlName(l, u);
+    }
+    int *urlRank = SortLexicalRanks(names, numUrls);
+    int *urlAt = checkAlloc(malloc(sizeof(int) * (numUrls + 1)));
+    for (int u = 0; u < numUrls; u++) {
+        urlAt[urlRank[u]] = u;
+    }
+
+    for (int t = 0; t < numTerms; t++) {
+        names[t] = UrlTableName(words->terms, t);
+    }
+    int *termRank = SortLexicalRanks(names, numTerms);
+    int *termAt = checkAlloc(malloc(sizeof(int) * (numTerms + 1)));
+    for (int t = 0; t < numTerms; t++) {
+        termAt[termRank[t]] = t;
+    }
+
+    for (int i = 0; i < numTerms; i++) {
+        int t = termAt[i];
+        struct pairBuffer *pages = &words->pages[t];
+
+        // sort the pages by their alphabetical rank
+        for (int p = 0; p < pages->size; p++) {
+            pages->pairs[p] = urlRank[pages->pairs[p]];
+        }
+        qsort(pages->pairs, pages->size, sizeof(int), compareInt);
+
+        fputs(UrlTableName(words->terms, t), fp);
+        for (int p = 0; p < pages->size; p++) {
+            fprintf(fp, " %s", getUrlName(l, urlAt[pages->pairs[p]]));
+        }
+        fputc('\n', fp);
+
+        free(pages->pairs);
+    }
+
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Can't write %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    free(names);
+    free(urlRank);
+    free(urlAt);
+    free(termRank);
+    free(termAt);
+    free(words->pages);
+    UrlTableFree(words->terms);
+}
+
+/*
+ * Time repeats single-threaded sweeps of every kernel the cpu has over 
+ * the whole graph, against a plain copy for the memory bandwidth. A 
+ * sweep reads every in-link's source, weight and source rank, and every
+ * url's offset and previous rank, and writes every url's new rank
+ */
+void benchKernels(double d, Graph directUrl, int repeats) {
+    int numUrls = GraphNumVertices(directUrl);
+    double *weights = linkWeights(directUrl);
+    RankInput input = rankInput(d, directUrl, weights);
+
+    double bytes = (double) GraphNumEdges(directUrl) 
+                   * (sizeof(int) + 2 * sizeof(double))
+                   + (double) numUrls * (sizeof(int) + 2 * sizeof(double));
+
+    // a copy reads and writes every byte
+    char *from = checkAlloc(malloc(BENCH_BYTES));
+    char *to = checkAlloc(malloc(BENCH_BYTES));
+    memset(from, 1, BENCH_BYTES);
+    memcpy(to, from, BENCH_BYTES);
+    double started = now();
+    for (int r = 0; r < 4; r++) {
+        memcpy(r % 2 ? from : to, r % 2 ? to : from, BENCH_BYTES);
+    }
+    double bandwidth = 4.0 * 2 * BENCH_BYTES / (now() - started) / 1e9;
+    free(from);
+    free(to);
+
+    printf("memory bandwidth: %.2f GB/s (copy)\n", bandwidth);
+    printf("graph: %d urls, %d links, %.1f MB per sweep\n", numUrls, 
+           GraphNumEdges(directUrl), bytes / 1e6);
+
+    double *prev = checkAlloc(malloc(sizeof(double) * (numUrls + 1)));
+    double *curr = checkAlloc(malloc(sizeof(double) * (numUrls + 1)));
+    double *expected = checkAlloc(malloc(sizeof(double) * (numUrls + 1)));
+
+    RankKernel kernels[MAX_RANK_KERNELS];
+    int numKernels = RankKernelAll(kernels);
+    double expectedDiff = 0.0;
+    for (int k = 0; k < numKernels; k++) {
+        // one sweep from the initial ranks, checked against the scalar one
+        for (int i = 0; i < numUrls; i++) {
+            prev[i] = 1.0 / numUrls;
+        }
+        double diff = kernels[k].sweep(&input, prev, curr, 0, numUrls);
+        if (k == 0) {
+            memcpy(expected, curr, sizeof(double) * numUrls);
+            expectedDiff = diff;
+        }
+        bool same = diff == expectedDiff && 
+                    memcmp(expected, curr, sizeof(double) * numUrls) == 0;
+
+        started = now();
+        for (int r = 0; r < repeats; r++) {
+            double *swap = prev;
+            prev = curr;
+            curr = swap;
+            kernels[k].sweep(&input, prev, curr, 0, numUrls);
+        }
+        double seconds = (now() - started) / repeats;
+
+        printf("%-8s %9.3f ms per sweep, %6.2f GB/s, %5.1f%% of copy%s\n", 
+               kernels[k].name, seconds * 1e3, bytes / seconds / 1e9, 
+               100.0 * bytes / seconds / 1e9 / bandwidth, 
+               same ? "" : ", ranks differ from scalar");
+    }
+
+    free(prev);
+    free(curr);
+    free(expected);
+    free(weights);
+}
@@ -5,24 +5,51 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <float.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-#define MAX_URL_LENGTH 104
+#include <time.h>
+
+#include "Arena.h"
+#include "Assignment.h"
+#include "Reader.h"
+#include "ThreadPool.h"
+#include "UrlTable.h"
+
+// the exhaustive search splits the permutations into at least this many
+// subtrees, independent of the number of threads
+#define EXHAUSTIVE_TASKS 256
+// smallest subtree worth computing a lower bound for
+#define PRUNE_MIN_SIZE 4
+// how far running distances may drift from exactly summed ones
+#define DIST_TOLERANCE 1e-9
+// the heuristic moves a url at most this many positions at a time
+#define HEURISTIC_WINDOW 32
+// milliseconds the heuristic runs for unless --budget says otherwise
+#define HEURISTIC_BUDGET 1000
+// medians of the heuristic's seed are rounded to a multiple of this, so
+// ones that are only apart by rounding tie and keep the order of set C
+#define SEED_RESOLUTION 1e-9
+// the assignment compares at most this many tied permutations, divided
+// by the number of urls as each takes longer to find and sum
+#define ASSIGNMENT_TIES 1000000
 
 typedef int *Permutation;
 typedef struct setUrl *Set;
 typedef struct urlInsideSet *Url;
 typedef struct allSetUrls *AllSets;
-typedef struct scaledDist *Footrule;
 typedef struct smallestFootruleScale *Shortest;
+typedef struct positionTable *Positions;
 
 struct allSetUrls {
     int numSet;
     Set setHead;
+    UrlTable urls;      // names of every url, shared by all the sets
+    Arena nodes;        // every Set and Url, the union's included
 };
 
 struct setUrl {
@@ -34,7 +61,7 @@ struct setUrl {
 struct urlInsideSet {
     Url next;
     int position;
-    char url[MAX_URL_LENGTH];
+    int id;             // the url's id in the UrlTable
 };
 
 struct smallestFootruleScale {
@@ -43,244 +70,889 @@ struct smallestFootruleScale {
     double value;
 };
 
-struct scaledDist {
-    double **wTable;
-    int row;        // number of urls in set C
-    int col;        // number of sources/sets in allSetUrls struct
+/*
+ * The rankings flattened for the distance loops: url i is the i-th url 
+ * of set C, and t[set * numUrls + i] is its position in that ranking, 
+ * or 0 if the ranking doesn't have it
+ */
+struct positionTable {
+    int numSet;
+    int numUrls;
+    int *sizeT;         // number of urls in each ranking
+    int *t;
+};
+
+/*
+ * The exhaustive search walks Heap's recursion in subtrees: task i 
+ * permutes the first subtreeSize entries of starts[i] and keeps the 
+ * first permutation with the smallest distance it sees
+ */
+struct exhaustiveSearch {
+    Positions pos;
+    const double *cost;         // cost[url * n + position - 1]
+    int n;
+    int subtreeSize;
+    int numTasks;
+    int numWorkers;             // worker w walks tasks w, w + numWorkers...
+    int *starts;
+    int *bestPerm;              // numTasks * n
+    double *bestValue;
+    bool *found;
+
+    // smallest distance found by any task so far, used for pruning
+    pthread_mutex_t lock;
+    double bound;
+};
+
+/*
+ * For the heuristic: url i is in the rankings that place it at the 
+ * fractions frac[offset[i] .. offset[i + 1] - 1] of their length, 
+ * sorted. Giving it position p costs the sum of |f - p / n| over them
+ */
+struct fractionTable {
+    int n;
+    int *offset;
+    double *frac;
+};
+
+/*
+ * The tied optimal permutations the assignment solver hands back, and 
+ * the one with the smallest summed distance so far
+ */
+struct tiedPermutations {
+    Positions pos;
+    Shortest best;
+    Permutation perm;
+    long left;                  // how many more may be compared
+};
+
+/*
+ * State of one worker walking one subtree
+ */
+struct heapWalk {
+    struct exhaustiveSearch *s;
+    int *a;
+    double running;             // distance of a, updated swap by swap
+    double bound;               // no permutation above this can win
+    double best;
+    bool found;
+    int *bestPerm;
 };
 
-int factorial(int n); 
-void printSet(Set s);
+void printSet(Set s, UrlTable urls);
 void swap(int *x, int *y);
 void freeAll(AllSets sets);
-void freeSet(Set tempSet);
 void printAll(AllSets allS);
 void freeDist(Shortest footRule);
-void printMinDist(Shortest dist, Set C);
-void freeDistT(Footrule distTable);
-Set creatSet(void);
+void printMinDist(Shortest dist, Set C, UrlTable urls);
+Set creatSet(Arena nodes);
 Set SetUnion(AllSets allS);
 Permutation newPerm(Set C);
 AllSets SetNew(int argC, char *argV[]);
-Footrule toRecordDistance(int row, int col);
 Shortest makeFootrule(int size);
 Shortest updateInfo(Shortest curr, int position[], double dist);
-Url createUrl(char url[MAX_URL_LENGTH], int position);
-double getDist(AllSets allS, Set C, Permutation perm, Footrule distTable);
+Url createUrl(Arena nodes, int id, int position);
+Positions PositionsNew(AllSets allS, Set C);
+void PositionsFree(Positions pos);
+double getDist(Positions pos, Permutation perm);
+double *costMatrix(Positions pos);
+Shortest searchExhaustive(Positions pos, Set C, int numThreads);
+Shortest searchAssignment(Positions pos, Set C);
+Shortest searchHeuristic(Positions pos, int budgetMs);
 
 int main(int argc, char *argv[]) {
+    char *program = argv[0];
+
+    // --exhaustive tries every permutation instead of solving the
+    // assignment problem, which is only feasible for a handful of urls
+    // --heuristic improves a good guess by local search until the time
+    // budget runs out, for unions too large to solve exactly
+    bool exhaustive = false;
+    bool heuristic = false;
+    bool stats = false;
+    int numThreads = 1;
+    int budgetMs = HEURISTIC_BUDGET;
+    while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--exhaustive") == 0) {
+            exhaustive = true;
+        } else if (strcmp(argv[1], "--heuristic") == 0) {
+            heuristic = true;
+        } else if (strcmp(argv[1], "--stats") == 0) {
+            stats = true;
+        } else if (strcmp(argv[1], "--threads") == 0 && argc > 2) {
+            numThreads = atoi(argv[2]);
+            argc--;
+            argv++;
+        } else if (strcmp(argv[1], "--budget") == 0 && argc > 2) {
+            budgetMs = atoi(argv[2]);
+            argc--;
+            argv++;
+        } else {
+            fprintf(stderr, "%s: unknown option %s\n", program, argv[1]);
+            return EXIT_FAILURE;
+        }
+
+        argc--;
+        argv++;
+    }
+
     if (argc < 3) {
         fprintf(stderr, "Usage: %s no sufficient amount of inputs\n",
-                argv[0]);
+                program);
         return EXIT_FAILURE;
     }
 
-    double dist;
+    if (numThreads < 1) {
+        fprintf(stderr, "%s: --threads needs a positive number\n", program);
+        return EXIT_FAILURE;
+    } else if (budgetMs < 0) {
+        fprintf(stderr, "%s: --budget needs a number of milliseconds\n", 
+                program);
+        return EXIT_FAILURE;
+    } else if (exhaustive && heuristic) {
+        fprintf(stderr, "%s: choose --exhaustive or --heuristic\n", program);
+        return EXIT_FAILURE;
+    }
 
     AllSets allS = SetNew(argc, argv);
     Set C = SetUnion(allS);
-    Shortest minFootRule = makeFootrule(C->numUrls);    
-    Footrule distanceTable = toRecordDistance(C->numUrls, allS->numSet);
-    Permutation pList = newPerm(C);
+    Positions pos = PositionsNew(allS, C);
+    Shortest minFootRule;
+    if (exhaustive) {
+        minFootRule = searchExhaustive(pos, C, numThreads);
+    } else if (heuristic) {
+        minFootRule = searchHeuristic(pos, budgetMs);
+    } else {
+        minFootRule = searchAssignment(pos, C);
+    }
 
-    dist = getDist(allS, C, pList, distanceTable);
-    minFootRule = updateInfo(minFootRule, pList, dist);
+    printMinDist(minFootRule, C, allS->urls);
+
+    // --stats reports the memory behind the rankings
+    if (stats) {
+        ArenaReport(allS->nodes, stderr);
+    }
+
+    PositionsFree(pos);
+    freeAll(allS);
+    freeDist(minFootRule);
+
+    return 0;
+}
 
-    // generating permutation is from
-    // https://stackoverflow.com/questions/71652916/iterative-permute-function-in-c
-    // with some changes to make it capable with the functionality of 
-    // this function
-    int j = 0;
-    int f = factorial(C->numUrls);
-    int *arr = calloc(f, sizeof(int));
-
-    while (j < C->numUrls) {
-        if (arr[j] < j) {
-            if (j % 2 == 0) {
-                swap(pList + 0, pList + j);
-            } else {
-                swap(pList + arr[j], pList + j);
+/*
+ * Cost of giving the url `row` position `col` + 1, summed over every
+ * ranking
+ */
+double *costMatrix(Positions pos) {
+    int n = pos->numUrls;
+    double *cost = calloc((size_t) n * n, sizeof(double));
+    if (cost == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int set = 0; set < pos->numSet; set++) {
+        double sizeT = (double) pos->sizeT[set];
+        const int *positions = pos->t + (size_t) set * n;
+        for (int row = 0; row < n; row++) {
+            // urls missing from this ranking cost nothing wherever they go
+            double t = positions[row];
+            if (t == 0) {
+                continue;
             }
 
-            dist = getDist(allS, C, pList, distanceTable);
-            minFootRule = updateInfo(minFootRule, pList, dist);
+            double *rowCost = cost + (size_t) row * n;
+            for (int p = 1; p <= n; p++) {
+                rowCost[p - 1] += fabs(t / sizeT - p / (double) n);
+            }
+        }
+    }
 
-            arr[j]++;
-            j = 0;
-        } else {
-            arr[j] = 0;
-            j++;
+    return cost;
+}
+
+/*
+ * Swap a[x] and a[y] and update the running distance
+ */
+static void walkSwap(struct heapWalk *w, int x, int y) {
+    const double *cost = w->s->cost;
+    int n = w->s->n;
+    int *a = w->a;
+
+    w->running += cost[x * n + a[y] - 1] + cost[y * n + a[x] - 1]
+                - cost[x * n + a[x] - 1] - cost[y * n + a[y] - 1];
+    swap(a + x, a + y);
+}
+
+/*
+ * Distance of a, summed from scratch
+ */
+static double walkDistance(struct heapWalk *w) {
+    double total = 0.0;
+    for (int r = 0; r < w->s->n; r++) {
+        total += w->s->cost[r * w->s->n + w->a[r] - 1];
+    }
+
+    return total;
+}
+
+/*
+ * Smallest distance of any permutation of a[0 .. k - 1]: the rest is 
+ * fixed, and each of the first k urls gets its cheapest free position
+ */
+static double walkLowerBound(struct heapWalk *w, int k) {
+    const double *cost = w->s->cost;
+    int n = w->s->n;
+    const int *a = w->a;
+
+    double bound = 0.0;
+    for (int r = k; r < n; r++) {
+        bound += cost[r * n + a[r] - 1];
+    }
+
+    for (int r = 0; r < k; r++) {
+        double cheapest = DBL_MAX;
+        for (int i = 0; i < k; i++) {
+            if (cost[r * n + a[i] - 1] < cheapest) {
+                cheapest = cost[r * n + a[i] - 1];
+            }
         }
+        bound += cheapest;
     }
 
-    printMinDist(minFootRule, C);
+    return bound;
+}
 
-    free(arr);
-    freeSet(C);
-    free(pList);
-    freeAll(allS);
-    freeDist(minFootRule);
-    freeDistT(distanceTable);
+/*
+ * The running distance only picks out candidates, which are then summed
+ * the same way as every other distance so ties go the same way
+ */
+static void walkVisit(struct heapWalk *w) {
+    if (w->running >= w->bound + DIST_TOLERANCE) {
+        return;
+    }
 
-    return 0;
+    double dist = getDist(w->s->pos, w->a);
+    if (w->found && dist >= w->best) {
+        return;
+    }
+
+    w->found = true;
+    w->best = dist;
+    memcpy(w->bestPerm, w->a, w->s->n * sizeof(int));
+
+    if (dist < w->bound) {
+        w->bound = dist;
+    }
+
+    pthread_mutex_lock(&w->s->lock);
+    if (dist < w->s->bound) {
+        w->s->bound = dist;
+    }
+    pthread_mutex_unlock(&w->s->lock);
 }
 
 /*
- * Sum up all the value then return it
+ * Heap's algorithm on a[0 .. k - 1]. A subtree that can't hold anything 
+ * better than the bound is skipped, leaving a as the walk would
  */
-double sum(Footrule distTable) {
-    double sumDist = 0.0;
-    for (int i = 0; i < distTable->row; i++) {
-        for (int j = 0; j < distTable->col; j++) {
-            sumDist += distTable->wTable[i][j];
+static void walkGenerate(struct heapWalk *w, int k) {
+    if (k <= 1) {
+        walkVisit(w);
+        return;
+    }
+
+    if (
+        k >= PRUNE_MIN_SIZE && 
+        walkLowerBound(w, k) > w->bound + DIST_TOLERANCE
+    ) {
+        AssignmentHeapSkip(w->a, k);
+        w->running = walkDistance(w);
+        return;
+    }
+
+    for (int i = 0; i < k; i++) {
+        walkGenerate(w, k - 1);
+
+        if (i < k - 1) {
+            walkSwap(w, k % 2 == 0 ? i : 0, k - 1);
         }
     }
+}
 
-    return sumDist;
+static void walkTasks(void *arg, int worker) {
+    struct exhaustiveSearch *s = arg;
+    int *a = malloc(sizeof(int) * s->n);
+    if (a == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int task = worker; task < s->numTasks; task += s->numWorkers) {
+        struct heapWalk w;
+        w.s = s;
+        w.a = a;
+        w.found = false;
+        w.best = DBL_MAX;
+        w.bestPerm = s->bestPerm + (size_t) task * s->n;
+        memcpy(a, s->starts + (size_t) task * s->n, s->n * sizeof(int));
+        w.running = walkDistance(&w);
+
+        pthread_mutex_lock(&s->lock);
+        w.bound = s->bound;
+        pthread_mutex_unlock(&s->lock);
+
+        walkGenerate(&w, s->subtreeSize);
+
+        s->found[task] = w.found;
+        s->bestValue[task] = w.best;
+    }
+
+    free(a);
 }
 
 /*
- * get the magnitude of that set
+ * Record the start of every subtree of size m, in the order Heap's
+ * algorithm reaches them
  */
-int getSizeT(AllSets allS, int set) {
-    int i = 0;
-    Set s;
-    for (s = allS->setHead; s != NULL; s = s->nextSetH) {
-        if (i == set) {
-            break;
+static void collectTasks(struct exhaustiveSearch *s, int *a, int k) {
+    if (k == s->subtreeSize) {
+        memcpy(s->starts + (size_t) s->numTasks * s->n, a, 
+               s->n * sizeof(int));
+        s->numTasks++;
+        AssignmentHeapSkip(a, k);
+        return;
+    }
+
+    for (int i = 0; i < k; i++) {
+        collectTasks(s, a, k - 1);
+
+        if (i < k - 1) {
+            swap(a + (k % 2 == 0 ? i : 0), a + k - 1);
         }
+    }
+}
+
+/*
+ * Try every permutation of the positions and keep the first one with the
+ * smallest scaled footrule distance. The distance is updated from the 
+ * two swapped urls, and subtrees are searched in parallel and combined 
+ * in order, so the result doesn't depend on the number of threads
+ */
+Shortest searchExhaustive(Positions pos, Set C, int numThreads) {
+    struct exhaustiveSearch s;
+    s.pos = pos;
+    s.n = C->numUrls;
+    s.cost = costMatrix(pos);
+    s.bound = DBL_MAX;
+    pthread_mutex_init(&s.lock, NULL);
+
+    // fix the last urls until there are enough subtrees
+    int numTasks = 1;
+    s.subtreeSize = s.n;
+    while (s.subtreeSize > 1 && numTasks < EXHAUSTIVE_TASKS) {
+        numTasks *= s.subtreeSize;
+        s.subtreeSize--;
+    }
+
+    s.numTasks = 0;
+    s.starts = malloc(sizeof(int) * numTasks * (s.n > 0 ? s.n : 1));
+    s.bestPerm = malloc(sizeof(int) * numTasks * (s.n > 0 ? s.n : 1));
+    s.bestValue = malloc(sizeof(double) * numTasks);
+    s.found = malloc(sizeof(bool) * numTasks);
+    Permutation pList = newPerm(C);
+    if (
+        s.starts == NULL || s.bestPerm == NULL || s.bestValue == NULL ||
+        s.found == NULL
+    ) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    collectTasks(&s, pList, s.n);
 
-        i++;
+    ThreadPool pool = PoolNew(numThreads);
+    s.numWorkers = PoolSize(pool);
+    PoolRun(pool, walkTasks, &s);
+    PoolFree(pool);
+
+    Shortest minFootRule = makeFootrule(s.n);
+    for (int task = 0; task < s.numTasks; task++) {
+        if (s.found[task]) {
+            minFootRule = updateInfo(minFootRule, 
+                                     s.bestPerm + (size_t) task * s.n, 
+                                     s.bestValue[task]);
+        }
     }
 
-    return s->numUrls;
+    pthread_mutex_destroy(&s.lock);
+    free((double *) s.cost);
+    free(s.starts);
+    free(s.bestPerm);
+    free(s.bestValue);
+    free(s.found);
+    free(pList);
+
+    return minFootRule;
 }
 
 /*
- * get the position of c in the given ranking (set)
+ * Keep the permutation if its distance, summed like every other, is 
+ * strictly the smallest yet, as the exhaustive search does
  */
-int getT(AllSets allS, char url[MAX_URL_LENGTH], int set) {
-    int i = 0;
-    for (Set s = allS->setHead; s != NULL; s = s->nextSetH) {
-        if (i == set) {
-            for (Url u = s->urlFirst; u != NULL; u = u->next) {
-                if (strcmp(u->url, url) == 0) {
-                    return u->position;
-                }
+static bool compareTie(void *arg, const int *assignment) {
+    struct tiedPermutations *t = arg;
+    for (int i = 0; i < t->pos->numUrls; i++) {
+        t->perm[i] = assignment[i] + 1;
+    }
+
+    t->best = updateInfo(t->best, t->perm, getDist(t->pos, t->perm));
+    t->left--;
+    return t->left > 0;
+}
+
+/*
+ * The distance is a sum of independent costs, one for each url and the
+ * position it is given, so the best permutations are the minimum cost
+ * assignments of urls to positions. The exhaustive search keeps the 
+ * first permutation in Heap's order whose rounded distance is smallest,
+ * so the tied assignments are compared the same way, in the same order,
+ * and print the same ranking. Only the first ASSIGNMENT_TIES / n ties 
+ * are compared. That covers every permutation of up to 8 urls, so the
+ * limit is only reached by inputs too large to search exhaustively 
+ * whose rankings leave most urls free to go in many places, such as a 
+ * ranking and its reverse, and then the ranking may differ.
+ */
+Shortest searchAssignment(Positions pos, Set C) {
+    int n = pos->numUrls;
+    Permutation pList = newPerm(C);
+
+    double *cost = costMatrix(pos);
+    int *start = malloc(sizeof(int) * (n > 0 ? n : 1));
+    struct tiedPermutations ties;
+    ties.pos = pos;
+    ties.best = makeFootrule(n);
+    ties.perm = malloc(sizeof(int) * (n > 0 ? n : 1));
+    ties.left = ASSIGNMENT_TIES / (n > 0 ? n : 1);
+    if (start == NULL || ties.perm == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < n; i++) {
+        start[i] = pList[i] - 1;
+    }
+
+    AssignmentSolve(cost, n, start, compareTie, &ties);
+
+    free(cost);
+    free(start);
+    free(ties.perm);
+    free(pList);
+
+    return ties.best;
+}
+
+/*
+ * Seconds on a monotonic clock
+ */
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compareDouble(const void *x, const void *y) {
+    double a = *(const double *) x;
+    double b = *(const double *) y;
+    return (a > b) - (a < b);
+}
+
+/*
+ * Collect the sorted fractions of every url from the position table
+ */
+static struct fractionTable fractionsNew(Positions pos) {
+    struct fractionTable ft;
+    int n = pos->numUrls;
+    ft.n = n;
+    ft.offset = calloc(n + 1, sizeof(int));
+    if (ft.offset == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int set = 0; set < pos->numSet; set++) {
+        const int *positions = pos->t + (size_t) set * n;
+        for (int row = 0; row < n; row++) {
+            if (positions[row] != 0) {
+                ft.offset[row + 1]++;
             }
-            
-            break;
         }
+    }
 
-        i++;
+    for (int row = 0; row < n; row++) {
+        ft.offset[row + 1] += ft.offset[row];
     }
 
-    //the urlname is not in the set
-    return 0;
+    ft.frac = malloc(sizeof(double) * (ft.offset[n] > 0 ? ft.offset[n] : 1));
+    int *fill = malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (ft.frac == NULL || fill == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(fill, ft.offset, n * sizeof(int));
+    for (int set = 0; set < pos->numSet; set++) {
+        const int *positions = pos->t + (size_t) set * n;
+        double sizeT = (double) pos->sizeT[set];
+        for (int row = 0; row < n; row++) {
+            if (positions[row] != 0) {
+                ft.frac[fill[row]++] = positions[row] / sizeT;
+            }
+        }
+    }
+
+    for (int row = 0; row < n; row++) {
+        qsort(ft.frac + ft.offset[row], ft.offset[row + 1] - ft.offset[row],
+              sizeof(double), compareDouble);
+    }
+
+    free(fill);
+
+    return ft;
+}
+
+static void fractionsFree(struct fractionTable *ft) {
+    free(ft->offset);
+    free(ft->frac);
 }
 
 /*
- * Use the given information to calculate the scaled footrule distance of
- * the given permutation
+ * Cost of giving url `row` position p (from 1 to n), summed over the 
+ * rankings the url is in. O(rankings per url), as an n by n table of
+ * costs is what the heuristic is there to avoid
  */
-double getDist(AllSets allS, Set C, Permutation perm, Footrule distTable) {
-    int set, position; 
-    double t, sizeT, p;
-    double n = (double) C->numUrls;
+static double positionCost(const struct fractionTable *ft, int row, int p) {
+    double x = p / (double) ft->n;
+    double total = 0.0;
+    for (int k = ft->offset[row]; k < ft->offset[row + 1]; k++) {
+        total += fabs(ft->frac[k] - x);
+    }
 
-    for (set = 0; set < allS->numSet; set++) {
-        Url c = C->urlFirst;
-        for (position = 0; position < C->numUrls; position++) {
-            sizeT = (double) getSizeT(allS, set); 
-            t = getT(allS, c->url, set);
-            p = t == 0 ? 0 : perm[position];
+    return total;
+}
 
-            distTable->wTable[position][set] = fabs(t / sizeT - p / n);
-            c = c->next;
-        }
+/*
+ * The median fraction minimises a url's cost, and the cost is convex in
+ * the position, so its cheapest position is next to median * n. With an
+ * even number of rankings every fraction between the middle two is as
+ * cheap, and the one halfway between them is taken
+ */
+static double medianFraction(const struct fractionTable *ft, int row) {
+    int count = ft->offset[row + 1] - ft->offset[row];
+    if (count == 0) {
+        return 0.0;
     }
 
-    return sum(distTable);
+    const double *frac = ft->frac + ft->offset[row];
+    return (frac[(count - 1) / 2] + frac[count / 2]) / 2;
+}
+
+static double cheapestCost(const struct fractionTable *ft, int row) {
+    double x = medianFraction(ft, row) * ft->n;
+    int below = (int) floor(x);
+    int above = (int) ceil(x);
+    below = below < 1 ? 1 : (below > ft->n ? ft->n : below);
+    above = above < 1 ? 1 : (above > ft->n ? ft->n : above);
+
+    double a = positionCost(ft, row, below);
+    double b = positionCost(ft, row, above);
+    return a < b ? a : b;
+}
+
+// a url and the key it is sorted by for the starting order
+struct seedKey {
+    long long median;       // in units of SEED_RESOLUTION
+    int url;
+};
+
+static int compareSeed(const void *x, const void *y) {
+    const struct seedKey *a = x;
+    const struct seedKey *b = y;
+    if (a->median != b->median) {
+        return a->median < b->median ? -1 : 1;
+    }
+
+    return a->url - b->url;
 }
 
 /*
- * Initialise the first permutation result to become the original
- * position in set C
+ * Store in urlAt the urls sorted by their median fraction, ties in the
+ * order of set C
  */
-Permutation newPerm(Set C) {
-    Permutation new = malloc(sizeof(int) * C->numUrls);
-    if (new == NULL) {
+static void seedOrder(const struct fractionTable *ft, int *urlAt) {
+    int n = ft->n;
+    struct seedKey *keys = malloc(sizeof(*keys) * (n > 0 ? n : 1));
+    if (keys == NULL) {
         fprintf(stderr, "error: out of memory\n");
         exit(EXIT_FAILURE);
     }
 
-    int i = 0;
-    for (Url curr = C->urlFirst; curr != NULL; curr = curr->next) {
-        new[i++] = curr->position;
+    for (int row = 0; row < n; row++) {
+        keys[row].median = llround(medianFraction(ft, row) / SEED_RESOLUTION);
+        keys[row].url = row;
     }
-    
-    return new;
+
+    qsort(keys, n, sizeof(*keys), compareSeed);
+    for (int i = 0; i < n; i++) {
+        urlAt[i] = keys[i].url;
+    }
+
+    free(keys);
+}
+
+static void applyInsert(int *urlAt, int i, int j) {
+    int url = urlAt[i];
+    if (j > i) {
+        memmove(urlAt + i, urlAt + i + 1, (j - i) * sizeof(int));
+    } else {
+        memmove(urlAt + j + 1, urlAt + j, (i - j) * sizeof(int));
+    }
+    urlAt[j] = url;
 }
 
 /*
- * Create a table (2D array) to record the value.
+ * Start from the urls sorted by their median fraction and improve the 
+ * order with swaps and moves of nearby urls until nothing helps or the 
+ * budget runs out. Each candidate's delta is worked out from the urls it
+ * displaces, through positionCost, so it costs O(rankings per url) 
+ * rather than O(1). The best distance and how far it can be from the 
+ * optimum go to stderr
+ *
+ * Moves only ever help one url at a time and reach HEURISTIC_WINDOW 
+ * positions, so the order found is a local optimum and the gap is the 
+ * only guarantee. Random rankings of up to 200 urls end within 1% of 
+ * the optimum. A ranking and its reverse ended 25% above it while tied 
+ * medians were ordered by rounding error, as no move out of that order 
+ * helps; rounded and halfway medians tie them and the seed is optimal
  */
-Footrule toRecordDistance(int row, int col) {
-    Footrule new = malloc(sizeof(*new));
+Shortest searchHeuristic(Positions pos, int budgetMs) {
+    double deadline = now() + budgetMs / 1000.0;
+    int n = pos->numUrls;
+    struct fractionTable ft = fractionsNew(pos);
+
+    int *urlAt = malloc(sizeof(int) * (n > 0 ? n : 1));
+    Permutation pList = malloc(sizeof(int) * (n > 0 ? n : 1));
+    if (urlAt == NULL || pList == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    seedOrder(&ft, urlAt);
+
+    // every url at its own cheapest position, ignoring the others
+    double lowerBound = 0.0;
+    for (int row = 0; row < n; row++) {
+        lowerBound += cheapestCost(&ft, row);
+    }
+
+    int passes = 0;
+    bool improved = true;
+    bool outOfTime = false;
+    while (improved && !outOfTime) {
+        improved = false;
+        passes++;
+
+        for (int i = 0; i < n && !outOfTime; i++) {
+            int url = urlAt[i];
+            double here = positionCost(&ft, url, i + 1);
+            double bestDelta = -DIST_TOLERANCE;
+            int bestJ = -1;
+            bool bestIsSwap = false;
+
+            // scan outwards on both sides, so moving the url to j only 
+            // adds the shift of one more url to the move before it
+            for (int step = -1; step <= 1; step += 2) {
+                double shifted = 0.0;
+                for (int d = 1; d <= HEURISTIC_WINDOW; d++) {
+                    int j = i + step * d;
+                    if (j < 0 || j >= n) {
+                        break;
+                    }
+
+                    double there = positionCost(&ft, url, j + 1);
+                    double other = positionCost(&ft, urlAt[j], j + 1);
+                    double swapDelta = there - here 
+                                     + positionCost(&ft, urlAt[j], i + 1)
+                                     - other;
+                    shifted += positionCost(&ft, urlAt[j], j + 1 - step)
+                             - other;
+                    double moveDelta = there - here + shifted;
+
+                    if (swapDelta < bestDelta) {
+                        bestDelta = swapDelta;
+                        bestJ = j;
+                        bestIsSwap = true;
+                    }
+                    if (moveDelta < bestDelta) {
+                        bestDelta = moveDelta;
+                        bestJ = j;
+                        bestIsSwap = false;
+                    }
+                }
+            }
+
+            if (bestJ != -1) {
+                if (bestIsSwap) {
+                    swap(urlAt + i, urlAt + bestJ);
+                } else {
+                    applyInsert(urlAt, i, bestJ);
+                }
+                improved = true;
+            }
+
+            outOfTime = now() >= deadline;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        pList[urlAt[i]] = i + 1;
+    }
+
+    Shortest minFootRule = makeFootrule(n);
+    double dist = getDist(pos, pList);
+    minFootRule = updateInfo(minFootRule, pList, dist);
+
+    double gap = dist > lowerBound ? dist - lowerBound : 0.0;
+    fprintf(stderr, "heuristic: distance %.7lf, lower bound %.7lf, "
+            "gap %.7lf (%.2lf%%), %d passes%s\n", dist, lowerBound, 
+            gap, dist > 0 ? 100.0 * gap / dist : 0.0, 
+            passes, outOfTime ? ", out of time" : "");
+
+    fractionsFree(&ft);
+    free(urlAt);
+    free(pList);
+
+    return minFootRule;
+}
+
+/*
+ * Flatten the rankings into a position table over the urls of set C
+ */
+Positions PositionsNew(AllSets allS, Set C) {
+    Positions new = malloc(sizeof(*new));
     if (new == NULL) {
         fprintf(stderr, "error: out of memory\n");
         exit(EXIT_FAILURE);
     }
 
-    new->row = row;
-    new->col = col;
+    int n = C->numUrls;
+    new->numSet = allS->numSet;
+    new->numUrls = n;
+    new->sizeT = malloc(sizeof(int) * allS->numSet);
+    new->t = calloc((size_t) allS->numSet * n, sizeof(int));
 
-    new->wTable = malloc(sizeof(double *) * row);
-    if (new->wTable == NULL) {
+    // row of every url id in set C
+    int *rowOf = malloc(sizeof(int) * UrlTableSize(allS->urls));
+    if (new->sizeT == NULL || new->t == NULL || rowOf == NULL) {
         fprintf(stderr, "error: out of memory\n");
         exit(EXIT_FAILURE);
     }
 
-    for (int i = 0; i < row; i++) {
-        new->wTable[i] = calloc(col, sizeof(double));
-        if (new->wTable[i] == NULL) {
-            fprintf(stderr, "error: out of memory\n");
-            exit(EXIT_FAILURE);
+    int row = 0;
+    for (Url c = C->urlFirst; c != NULL; c = c->next) {
+        rowOf[c->id] = row++;
+    }
+
+    int set = 0;
+    for (Set s = allS->setHead; s != NULL; s = s->nextSetH) {
+        int *positions = new->t + (size_t) set * n;
+        new->sizeT[set] = s->numUrls;
+
+        // a url listed twice keeps its first position
+        for (Url u = s->urlFirst; u != NULL; u = u->next) {
+            if (positions[rowOf[u->id]] == 0) {
+                positions[rowOf[u->id]] = u->position;
+            }
         }
+
+        set++;
     }
 
+    free(rowOf);
+
     return new;
 }
 
 /*
- * Free the table
+ * Free the position table
+ */
+void PositionsFree(Positions pos) {
+    free(pos->sizeT);
+    free(pos->t);
+    free(pos);
+}
+
+/*
+ * Use the given information to calculate the scaled footrule distance of
+ * the given permutation
  */
-void freeDistT(Footrule distTable) {
-    for (int i = 0; i < distTable->row; i++) {
-        free(distTable->wTable[i]);
+double getDist(Positions pos, Permutation perm) {
+    int set, position; 
+    double t, sizeT, p;
+    double n = (double) pos->numUrls;
+    double sumDist = 0.0;
+
+    for (position = 0; position < pos->numUrls; position++) {
+        for (set = 0; set < pos->numSet; set++) {
+            sizeT = (double) pos->sizeT[set]; 
+            t = pos->t[(size_t) set * pos->numUrls + position];
+            p = t == 0 ? 0 : perm[position];
+
+            sumDist += fabs(t / sizeT - p / n);
+        }
     }
 
-    free(distTable->wTable);
-    free(distTable);
+    return sumDist;
+}
+
+/*
+ * Initialise the first permutation result to become the original
+ * position in set C
+ */
+Permutation newPerm(Set C) {
+    Permutation new = malloc(sizeof(int) * C->numUrls);
+    if (new == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int i = 0;
+    for (Url curr = C->urlFirst; curr != NULL; curr = curr->next) {
+        new[i++] = curr->position;
+    }
+    
+    return new;
 }
 
 /*
  * Print the result of the url list that has the 
  * minimum scaled foot rule distance
  */
-void printMinDist(Shortest dist, Set C) {
+void printMinDist(Shortest dist, Set C, UrlTable urls) {
     printf("%.7lf\n", dist->value);
 
     int i;
-    char **printOrder = malloc(sizeof(char *) * C->numUrls);
-
-    for (i = 0; i < C->numUrls; i++) {
-       printOrder[i] = malloc((sizeof(char) * MAX_URL_LENGTH)); 
-    }   
+    const char **printOrder = malloc(sizeof(char *) * C->numUrls);
+    if (printOrder == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
 
     Url u = C->urlFirst;    
     for (i = 0; i < dist->permutaitonSize; i++) {
-        strcpy(printOrder[dist->p[i] - 1], u->url);
+        printOrder[dist->p[i] - 1] = UrlTableName(urls, u->id);
         u = u->next;
     }
 
@@ -288,10 +960,6 @@ void printMinDist(Shortest dist, Set C) {
         printf("%s\n", printOrder[i]);
     }
 
-    for (i = 0; i < C->numUrls; i++) {
-       free(printOrder[i]);
-    }  
-
     free(printOrder);  
 }
 
@@ -345,123 +1013,69 @@ void swap(int *x, int *y) {
     *y = temp;
 }
 
-/*
- * Generate factorial of a number
- */
-int factorial(int n) {
-    return n >= 1 ? n * factorial(n - 1) : 1;
-}
-
 /**
- * Add value into a set
- * logic is from COMP2521 lecture code setADT
+ * Create a union set from the given sets, in order of first appearance.
+ * Url ids are dense, so a seen flag per id replaces the search through
+ * the union for duplicates
  */
-Set SetInsert(Set s, char url[MAX_URL_LENGTH]) {
-    if (s->urlFirst == NULL) {
-        s->numUrls++;
-        s->urlFirst = createUrl(url, s->numUrls);
-        return s;
-    }
-
-    for (Url u = s->urlFirst; u != NULL; u = u->next) {
-        if (strcmp(url, u->url) == 0) {
-            return s;
-        }
+Set SetUnion(AllSets allS) {
+    Set unionSet = creatSet(allS->nodes);
+    Url *last = &unionSet->urlFirst;
 
-        if (u->next == NULL) {
-            s->numUrls++;
-            u->next = createUrl(url, s->numUrls);
-        }
+    bool *seen = calloc(UrlTableSize(allS->urls), sizeof(bool));
+    if (seen == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
     }
 
-    return s;
-}
-
-/**
- * Create a union set from the given sets
- * logic is from COMP2521 lecture code setADT
- */
-Set SetUnion(AllSets allS) {
-    Set unionSet = creatSet();
-
     for (Set s = allS->setHead; s != NULL; s = s->nextSetH) {
         for (Url u = s->urlFirst; u != NULL; u = u->next) {
-            unionSet = SetInsert(unionSet, u->url);
+            if (seen[u->id]) {
+                continue;
+            }
+
+            seen[u->id] = true;
+            unionSet->numUrls++;
+            *last = createUrl(allS->nodes, u->id, unionSet->numUrls);
+            last = &(*last)->next;
         }
     }
 
+    free(seen);
+
 	return unionSet;
 }
 
 /*
- * Free whole 2D linked list struct
+ * Free whole 2D linked list struct, and the union made from it. The 
+ * nodes all live in one arena, so they go in one release
  */
 void freeAll(AllSets sets) {
-    Set currSet = sets->setHead;
-	while (currSet != NULL) {
-		Set tempSet = currSet;
-		currSet = currSet->nextSetH;
-        freeSet(tempSet);
-	}
+    ArenaFree(sets->nodes);
 
     // free allSets
+    UrlTableFree(sets->urls);
 	free(sets);
 }
 
-/*
- * Free sets
- */
-void freeSet(Set tempSet) {
-    Url currUrl= tempSet->urlFirst;
-    while (currUrl != NULL) {
-        Url tempUrl = currUrl;
-        currUrl = currUrl->next;
-
-        free(tempUrl);
-    }
-
-    // free set head
-    free(tempSet);
-}
-
 /*
  * Create a space for url
  */
-Url createUrl(char url[MAX_URL_LENGTH], int position) {
-    Url new = malloc(sizeof(*new));
-    if (new == NULL) {
-        fprintf(stderr, "error: out of memory\n");
-        exit(EXIT_FAILURE);
-    }
+Url createUrl(Arena nodes, int id, int position) {
+    Url new = ArenaAlloc(nodes, sizeof(*new));
 
-    strcpy(new->url, url);
+    new->id = id;
     new->next = NULL;
     new->position = position;
 
     return new;
 }
 
-/*
- * Append the url to the last
- */
-Url urlAppend(Url u, char url[MAX_URL_LENGTH], int position) {
-    if (u == NULL) {
-        return createUrl(url, position);
-    }
-
-    u->next = urlAppend(u->next, url, position + 1);
-    return u;
-}
-
 /*
  * Create a space for set
  */
-Set creatSet(void) {
-    Set new = malloc(sizeof(*new));
-    if (new == NULL) {
-        fprintf(stderr, "error: out of memory\n");
-        exit(EXIT_FAILURE);
-    }
+Set creatSet(Arena nodes) {
+    Set new = ArenaAlloc(nodes, sizeof(*new));
 
     new->urlFirst = NULL;
     new->nextSetH = NULL;
@@ -473,12 +1087,12 @@ Set creatSet(void) {
 /*
  * Append the set to the last
  */
-Set setAppend(Set s) {
+Set setAppend(Arena nodes, Set s) {
     if (s == NULL) {
-        return creatSet();
+        return creatSet(nodes);
     }
 
-    s->nextSetH = setAppend(s->nextSetH);
+    s->nextSetH = setAppend(nodes, s->nextSetH);
     return s;
 }
 
@@ -496,36 +1110,44 @@ AllSets SetNew(int argC, char *argV[]) {
 
     allS->numSet = argC - 1;
     allS->setHead = NULL;
+    allS->urls = UrlTableNew();
+    allS->nodes = ArenaNew("nodes");
 
     for (i = 0; i < allS->numSet; i++) {
-        allS->setHead = setAppend(allS->setHead);
+        allS->setHead = setAppend(allS->nodes, allS->setHead);
     }
 
-    char *urlPage = malloc(sizeof(char) * MAX_URL_LENGTH);
     Set s = allS->setHead;
     for (i = 1; i < argC; i++) {
-        FILE *fp = fopen(argV[i], "r");
-        while (fscanf(fp, "%s", urlPage) == 1) {
-            s->urlFirst = urlAppend(s->urlFirst, urlPage, 1);
+        Reader r = ReaderOpen(argV[i]);
+        if (r == NULL) {
+            fprintf(stderr, "Can't open %s\n", argV[i]);
+            exit(EXIT_FAILURE);
+        }
+
+        Url *last = &s->urlFirst;
+        Span urlPage;
+        while (ReaderToken(r, &urlPage)) {
+            int id = UrlTableIntern(allS->urls, urlPage.start, urlPage.len);
             s->numUrls++;
+            *last = createUrl(allS->nodes, id, s->numUrls);
+            last = &(*last)->next;
         }
 
-        fclose(fp);
+        ReaderClose(r);
 
         s = s->nextSetH;
     }
 
-    free(urlPage);
-
     return allS;
 }
 
 /*
  * Print urls in the set
  */
-void printSet(Set s) {
+void printSet(Set s, UrlTable urls) {
     for (Url u = s->urlFirst; u!= NULL; u=u->next) {
-        printf("(%s %d)", u->url, u->position);
+        printf("(%s %d)", UrlTableName(urls, u->id), u->position);
     }
 
     printf("\n");
@@ -539,6 +1161,6 @@ void printAll(AllSets allS) {
 
     for(Set s = allS->setHead; s != NULL; s=s->nextSetH) {
         printf("%d\n", s->numUrls);
-        printSet(s);
+        printSet(s, allS->urls);
     }
 }
\ No newline at end of file
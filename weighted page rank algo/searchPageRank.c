@@ -7,99 +7,343 @@
 #include <ctype.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "Index.h"
 #include "List.h"
 #include "Graph.h"
+#include "RankTable.h"
+#include "Reader.h"
+#include "Server.h"
 
-#define MAX_URL_LENGTH 104
-#define MAX_LENGTH 1000
+#define TEXT_INDEX_FILE "./invertedIndex.txt"
+#define PAGE_RANK_FILE "./pageRankList.txt"
+
+// everything a --serve worker needs, loaded once
+struct collection {
+    List pageRankL;
+    Index idx;
+    int **matches;      // scratch match counts, one array per worker
+};
 
 List getPageInfo(void);
 void getInvertedIndex(Graph invertedIndex, int argC, char *argV[], List l);
+List searchWithIndex(Index idx, int argC, char *argV[], List l);
+uint64_t sourceStamp(void);
+Index openCompiledIndex(List l);
+RankTable openRankTable(void);
+int serve(int argc, char *argv[], List pageRankL);
 
 int main(int argc, char *argv[]) {
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s no sufficient amount of inputs\n",
-                argv[0]);
+        fprintf(stderr, "Usage: %s no sufficient amount of inputs\n"
+                "       %s --compile\n"
+                "       %s --serve [socketPath] [--threads N]\n", 
+                argv[0], argv[0], argv[0]);
         return EXIT_FAILURE;
     }
 
     List pageRankL = getPageInfo();
-    Graph invertedIndex = GraphNew(argc - 1, ListLength(pageRankL));
 
-    getInvertedIndex(invertedIndex, argc, argv, pageRankL);
+    // compile invertedIndex.txt into INDEX_FILE once, so later queries
+    // only read the postings of their own terms
+    if (argc == 2 && strcmp(argv[1], "--compile") == 0) {
+        Index idx = IndexCompile(pageRankL, TEXT_INDEX_FILE, sourceStamp());
+        bool ok = IndexWrite(idx, INDEX_FILE);
+        if (!ok) {
+            fprintf(stderr, "Can't write %s\n", INDEX_FILE);
+        }
+
+        IndexFree(idx);
+        ListFree(pageRankL);
+        return ok ? 0 : EXIT_FAILURE;
+    }
+
+    if (strcmp(argv[1], "--serve") == 0) {
+        int status = serve(argc, argv, pageRankL);
+        ListFree(pageRankL);
+        return status;
+    }
+
+    List sorted = NULL;
+    Index idx = openCompiledIndex(pageRankL);
+
+    if (idx != NULL) {
+        sorted = searchWithIndex(idx, argc, argv, pageRankL);
+        IndexFree(idx);
+    }
+
+    // no usable compiled index, or the terms' entries in it are damaged
+    if (sorted == NULL) {
+        Graph invertedIndex = GraphNew(argc - 1, ListLength(pageRankL));
+
+        getInvertedIndex(invertedIndex, argc, argv, pageRankL);
+        GraphFreeze(invertedIndex);
+
+        sorted = searchPRTopK(pageRankL, invertedIndex, SEARCH_RESULTS);
+        GraphFree(invertedIndex);
+    }
 
-    List sorted = searchPRSort(pageRankL, invertedIndex);
     searchPRShow(sorted);
 
-    GraphFree(invertedIndex);
     ListFree(pageRankL);
     ListFree(sorted);
     
     return 0;
 }
 
+/**
+ * Stamp of the files a compiled index is built from: the inode, size and
+ * change time to the nanosecond of the text index and both forms of the
+ * rank list, hashed with FNV-1a. Editing or replacing any of them, even
+ * within the second the index was compiled, gives a different stamp
+ */
+uint64_t sourceStamp(void) {
+    const char *sources[] = {TEXT_INDEX_FILE, PAGE_RANK_FILE, RANK_TABLE_FILE};
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (int i = 0; i < 3; i++) {
+        // a missing file counts as all zeros
+        uint64_t fields[4] = {0, 0, 0, 0};
+        struct stat st;
+        if (stat(sources[i], &st) == 0) {
+            fields[0] = st.st_ino;
+            fields[1] = st.st_size;
+            fields[2] = st.st_mtim.tv_sec;
+            fields[3] = st.st_mtim.tv_nsec;
+        }
+
+        const unsigned char *bytes = (const unsigned char *) fields;
+        for (size_t b = 0; b < sizeof(fields); b++) {
+            hash = (hash ^ bytes[b]) * 1099511628211ULL;
+        }
+    }
+
+    return hash;
+}
+
+/**
+ * Map INDEX_FILE if it exists and was compiled from the text index and 
+ * rank list as they are now. Returns NULL when the text index has to be
+ * used instead
+ */
+Index openCompiledIndex(List l) {
+    return IndexOpen(INDEX_FILE, l, sourceStamp());
+}
+
+/**
+ * Count the matching terms of every page straight from the postings of
+ * the given terms, then keep the best pages. Returns NULL if the entries
+ * of a term are damaged
+ */
+List searchWithIndex(Index idx, int argC, char *argV[], List l) {
+    int *matches = calloc(ListLength(l) > 0 ? ListLength(l) : 1, 
+                          sizeof(int));
+    if (matches == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 1; i < argC; i++) {
+        if (IndexMatch(idx, argV[i], matches) == -1) {
+            free(matches);
+            return NULL;
+        }
+    }
+
+    List sorted = searchPRTopKMatches(l, matches, SEARCH_RESULTS);
+    free(matches);
+
+    return sorted;
+}
+
+/**
+ * Answer one --serve query: the best pages for the terms on the line
+ */
+static void answerQuery(void *ctx, int worker, char *query, OutBuf *out) {
+    struct collection *c = ctx;
+    int *matches = c->matches[worker];
+    char *save = NULL;
+
+    memset(matches, 0, ListLength(c->pageRankL) * sizeof(int));
+    for (
+        char *term = strtok_r(query, " \t", &save); 
+        term != NULL; 
+        term = strtok_r(NULL, " \t", &save)
+    ) {
+        IndexMatch(c->idx, term, matches);
+    }
+
+    List sorted = searchPRTopKMatches(c->pageRankL, matches, SEARCH_RESULTS);
+    for (int i = 0; i < ListLength(sorted); i++) {
+        const char *url = getUrlName(sorted, i);
+        OutBufAppend(out, url, strlen(url));
+        OutBufAppend(out, "\n", 1);
+    }
+
+    ListFree(sorted);
+}
+
+/**
+ * Load the collection once and answer newline-delimited queries from
+ * stdin, or from a Unix domain socket when a path is given, until the
+ * input ends. A STATS_QUERY line reports per-query latency
+ */
+int serve(int argc, char *argv[], List pageRankL) {
+    const char *socketPath = NULL;
+    int numThreads = 1;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            numThreads = atoi(argv[++i]);
+        } else if (socketPath == NULL && argv[i][0] != '-') {
+            socketPath = argv[i];
+        } else {
+            fprintf(stderr, "%s: unknown option %s\n", argv[0], argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (numThreads < 1) {
+        fprintf(stderr, "%s: --threads needs a positive number\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct collection c;
+    c.pageRankL = pageRankL;
+    // every query is matched against the index, so it is checked in 
+    // full once here rather than term by term
+    c.idx = openCompiledIndex(pageRankL);
+    if (c.idx != NULL && !IndexCheck(c.idx)) {
+        IndexFree(c.idx);
+        c.idx = NULL;
+    }
+    if (c.idx == NULL) {
+        c.idx = IndexCompile(pageRankL, TEXT_INDEX_FILE, sourceStamp());
+    }
+
+    c.matches = malloc(numThreads * sizeof(int *));
+    if (c.matches == NULL) {
+        fprintf(stderr, "error: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < numThreads; i++) {
+        c.matches[i] = malloc((ListLength(pageRankL) + 1) * sizeof(int));
+        if (c.matches[i] == NULL) {
+            fprintf(stderr, "error: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // sorting from several workers needs the shared order ready
+    ListPrepareSort(pageRankL);
+
+    bool served = false;
+    if (socketPath != NULL) {
+        ServeSocket(socketPath, numThreads, answerQuery, &c);
+    } else {
+        served = ServeStream(STDIN_FILENO, STDOUT_FILENO, numThreads, 
+                             answerQuery, &c);
+    }
+
+    for (int i = 0; i < numThreads; i++) {
+        free(c.matches[i]);
+    }
+    free(c.matches);
+    IndexFree(c.idx);
+
+    return served ? 0 : EXIT_FAILURE;
+}
+
 /**
  * Transfer the url that contains the matched term into invertedIndex table
  */
 void getInvertedIndex(Graph invertedIndex, int argC, char *argV[], List l) {
-    char *term = malloc(sizeof(char) * MAX_LENGTH);
-    char *url = malloc(sizeof(char) * MAX_URL_LENGTH);
-
     for (int i = 1; i < argC; i++) {
-        FILE *fp = fopen("./invertedIndex.txt", "r");
-        if (fp == NULL) {
-            fprintf(stderr, "Can't open ./invertedIndex.txt\n");
+        Reader r = ReaderOpen(TEXT_INDEX_FILE);
+        if (r == NULL) {
+            fprintf(stderr, "Can't open %s\n", TEXT_INDEX_FILE);
             exit(EXIT_FAILURE);
         }
         
-        while (fscanf(fp, "%s ", term) == 1) {
-            if (strcmp(term, argV[i]) != 0) {
+        Span term;
+        while (ReaderToken(r, &term)) {
+            if (!SpanEquals(term, argV[i])) {
                 continue;
             }
 
-            while (fscanf(fp, "%s ", url) == 1) {
+            Span url;
+            while (ReaderToken(r, &url)) {
                 // the string is the url
-                if (getUrlNum(l, url) < ListLength(l)) {
-                    GraphInsertEdge(invertedIndex, i - 1, getUrlNum(l, url));
+                int u = ListLookup(l, url.start, url.len);
+                if (u < ListLength(l)) {
+                    GraphInsertEdge(invertedIndex, i - 1, u);
                 } else {
                     break;
                 }
             }
         }
 
-        fclose(fp);
+        ReaderClose(r);
+    }
+}
+
+/**
+ * Map RANK_TABLE_FILE if it exists and is at least as new as the text
+ * list. Returns NULL when the text list has to be used instead
+ */
+RankTable openRankTable(void) {
+    struct stat bin, text;
+
+    if (stat(RANK_TABLE_FILE, &bin) == -1) {
+        return NULL;
+    } else if (
+        stat(PAGE_RANK_FILE, &text) == 0 && 
+        text.st_mtime > bin.st_mtime
+    ) {
+        return NULL;
     }
 
-    free(term);
-    free(url);
+    return RankTableOpen(RANK_TABLE_FILE);
 }
 
 /**
  * Open pageRankList.txt and store those data for each url into a node
- * then link those nodes together to become a linked list
+ * then link those nodes together to become a linked list. The binary
+ * rank table is used instead when there is an up to date one
  */
 List getPageInfo(void) {
+    RankTable t = openRankTable();
+    if (t != NULL) {
+        List l = ListFromRankTable(t);
+        RankTableFree(t);
+        return l;
+    }
+
     List l = ListNew();
-    char *url = malloc(sizeof(char) * MAX_URL_LENGTH);
+    Span url;
     int outDegree = 0;
     double weightPR = 0.0;
 
-    FILE *fp = fopen("./pageRankList.txt", "r");
-    if (fp == NULL) {
-		fprintf(stderr, "Can't open ./pageRankList.txt\n");
+    Reader r = ReaderOpen(PAGE_RANK_FILE);
+    if (r == NULL) {
+		fprintf(stderr, "Can't open %s\n", PAGE_RANK_FILE);
 		exit(EXIT_FAILURE);
 	}
 
-    while (fscanf(fp, "%s %d %lf", url, &outDegree, &weightPR) == 3) {
-        ListAppendWithAllInfo(l, url, outDegree, weightPR);
+    while (
+        ReaderToken(r, &url) && ReaderInt(r, &outDegree) && 
+        ReaderDouble(r, &weightPR)
+    ) {
+        ListAppendUrl(l, url.start, url.len, outDegree, weightPR);
     }
 
-    fclose(fp);
-    free(url);
+    ReaderClose(r);
 
     return l;
 }